@@ -0,0 +1,100 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Copy kernels for array values between a record and a pvData array.
+ *
+ * Contiguous copies of the same type are done with memcpy, which is
+ * what large waveforms need to run at memory bandwidth.
+ * The other loops are kept simple, without aliasing or calls, so that
+ * the compiler can vectorize them. Strided loops are unrolled by four.
+ *
+ * Records like compress keep their array in a circular buffer, in which
+ * the first element is at the offset given by get_array_info.
+ * gatherRingElements reads such a buffer in at most two segments
+ * (more only for strides that wrap several times).
+ */
+
+#ifndef ARRAYCOPY_H
+#define ARRAYCOPY_H
+
+#include <cstddef>
+#include <cstring>
+
+namespace epics { namespace pvaSrv {
+
+/* Copies count elements, converting each from From to To */
+template<typename To, typename From>
+inline void copyElements(To *to, const From *from, size_t count)
+{
+    for(size_t i=0; i<count; i++) to[i] = static_cast<To>(from[i]);
+}
+
+template<typename T>
+inline void copyElements(T *to, const T *from, size_t count)
+{
+    if(count>0) memcpy(to, from, count*sizeof(T));
+}
+
+/* to[i] = from[i*stride] for i<count */
+template<typename To, typename From>
+inline void gatherElements(
+    To *to, const From *from, size_t count, size_t stride)
+{
+    if(stride==1) {
+        copyElements(to, from, count);
+        return;
+    }
+    size_t i = 0;
+    for(; i+4<=count; i+=4, from+=4*stride) {
+        to[i] = static_cast<To>(from[0]);
+        to[i+1] = static_cast<To>(from[stride]);
+        to[i+2] = static_cast<To>(from[2*stride]);
+        to[i+3] = static_cast<To>(from[3*stride]);
+    }
+    for(; i<count; i++, from+=stride) to[i] = static_cast<To>(*from);
+}
+
+/* to[i*stride] = from[i] for i<count */
+template<typename To, typename From>
+inline void scatterElements(
+    To *to, const From *from, size_t count, size_t stride)
+{
+    if(stride==1) {
+        copyElements(to, from, count);
+        return;
+    }
+    size_t i = 0;
+    for(; i+4<=count; i+=4, to+=4*stride) {
+        to[0] = static_cast<To>(from[i]);
+        to[stride] = static_cast<To>(from[i+1]);
+        to[2*stride] = static_cast<To>(from[i+2]);
+        to[3*stride] = static_cast<To>(from[i+3]);
+    }
+    for(; i<count; i++, to+=stride) *to = static_cast<To>(from[i]);
+}
+
+/* to[i] = buffer[(start+i*stride)%capacity] for i<count,
+ * where buffer is a circular buffer of capacity elements
+ */
+template<typename To, typename From>
+inline void gatherRingElements(
+    To *to, const From *buffer, size_t capacity,
+    size_t start, size_t count, size_t stride)
+{
+    if(capacity==0) return;
+    start %= capacity;
+    while(count>0) {
+        // the elements before the end of the buffer
+        size_t n = (capacity - start + stride - 1)/stride;
+        if(n>count) n = count;
+        gatherElements(to, buffer + start, n, stride);
+        to += n;
+        count -= n;
+        start = (start + n*stride)%capacity;
+    }
+}
+
+}}
+
+#endif  /* ARRAYCOPY_H */
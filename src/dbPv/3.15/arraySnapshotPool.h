@@ -0,0 +1,71 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Recycles the buffers of array snapshots.
+ *
+ * A snapshot is copied from the record once, frozen and then shared by
+ * every monitor element that holds it. The pool remembers the last
+ * snapshots it handed out. When a new snapshot of the same size is needed
+ * and nothing but the pool references an old one any more, its buffer is
+ * thawed (without a copy) and reused instead of allocating a new one.
+ *
+ * A pool is used by a single producer and needs no lock: only the pool can
+ * create new references to a buffer that it holds the last reference to.
+ */
+
+#ifndef ARRAYSNAPSHOTPOOL_H
+#define ARRAYSNAPSHOTPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <pv/sharedVector.h>
+
+namespace epics { namespace pvaSrv {
+
+class ArraySnapshotPool {
+public:
+    ArraySnapshotPool()
+    : next(0)
+    {}
+    void setCapacity(size_t capacity)
+    {
+        snapshots.clear();
+        snapshots.resize(capacity);
+        next = 0;
+    }
+    /* Returns a buffer with room for length elements,
+     * reused if possible. The contents are undefined.
+     */
+    template<typename T>
+    epics::pvData::shared_vector<T> take(size_t length)
+    {
+        for(size_t i=0; i<snapshots.size(); i++) {
+            epics::pvData::shared_vector<const void> &snapshot = snapshots[i];
+            if(snapshot.size()!=length*sizeof(T)) continue;
+            if(!snapshot.unique()) continue;
+            epics::pvData::shared_vector<const T> buffer(
+                epics::pvData::static_shared_vector_cast<const T>(snapshot));
+            snapshot.clear();
+            return epics::pvData::thaw(buffer);
+        }
+        return epics::pvData::shared_vector<T>(length);
+    }
+    /* Remembers a frozen snapshot so that its buffer can be reused */
+    template<typename T>
+    void keep(epics::pvData::shared_vector<const T> const & snapshot)
+    {
+        if(snapshots.empty()) return;
+        snapshots[next] =
+            epics::pvData::static_shared_vector_cast<const void>(snapshot);
+        next = (next+1)%snapshots.size();
+    }
+private:
+    std::vector<epics::pvData::shared_vector<const void> > snapshots;
+    size_t next;
+};
+
+}}
+
+#endif  /* ARRAYSNAPSHOTPOOL_H */
@@ -13,16 +13,17 @@
 #include <cstddef>
 #include <string>
 #include <cstdio>
-#include <algorithm>
 
+#include <epicsAtomic.h>
 #include <epicsExit.h>
+#include <epicsThread.h>
 #include <cadef.h>
 #include <db_access.h>
 #include <dbDefs.h>
 #include <errlog.h>
 
 #include "caContext.h"
-#include "dbPvDebug.h"
+#include "dbPvTrace.h"
 
 using namespace epics::pvData;
 using namespace epics::pvaSrv;
@@ -32,7 +33,7 @@ extern "C" {
 
 static void exceptionCallback(struct exception_handler_args args)
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::exceptionCallback\n");
+    DBPV_TRACE(caTrace, 1, "caContext::exceptionCallback");
     caContext *context = static_cast<caContext *>(args.usr);
     string message(ca_message(args.stat));
     context->exception(message);
@@ -40,12 +41,21 @@ static void exceptionCallback(struct exception_handler_args args)
 
 static void threadExitFunc(void *arg)
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::threadExitFunc\n");
+    DBPV_TRACE(caTrace, 1, "caContext::threadExitFunc");
     caContext * context = static_cast<caContext * >(arg);
     std::tr1::shared_ptr<caContext> self(context->shared_from_this());
     self->stop();
 }
 
+// the caContextPtr of the context the thread created
+static epicsThreadPrivateId contextId;
+static epicsThreadOnceId contextIdOnce = EPICS_THREAD_ONCE_INIT;
+
+static void contextIdInit(void *)
+{
+    contextId = epicsThreadPrivateCreate();
+}
+
 } // extern "C"
 
 caContext::caContext(RequesterPtr const & requester)
@@ -55,7 +65,7 @@ caContext::caContext(RequesterPtr const & requester)
   context(0),
   referenceCount(0)
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::caContext\n");
+    DBPV_TRACE(caTrace, 1, "caContext::caContext");
     SEVCHK(ca_context_create(ca_enable_preemptive_callback),
         "caContext::caContext calling ca_context_create");
     int status = ca_add_exception_event(exceptionCallback,this);
@@ -68,51 +78,40 @@ caContext::caContext(RequesterPtr const & requester)
 
 caContext::~caContext()
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::~caContext\n");
+    DBPV_TRACE(caTrace, 1, "caContext::~caContext");
 }
 
 // TODO commented out exceptions to avoid SIGSEGs (to reproduce: pvget -m counter01 and then CTRL+C the pvget)
 void caContext::stop()
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::stop\n");
+    DBPV_TRACE(caTrace, 1, "caContext::stop");
     epicsThreadId id = epicsThreadGetIdSelf();
     if(id!=threadId) {
         printf("caContext::stop not same thread\n");
     	return;
     }
-    {
-        Lock xx(mutex);
-        if(referenceCount!=0) {
-            printf("caContext::stop referenceCount != 0 value %d\n",
-                   referenceCount);
-            return;
-        }
+    int count = epicsAtomicGetIntT(&referenceCount);
+    if(count!=0) {
+        printf("caContext::stop referenceCount != 0 value %d\n", count);
+        return;
     }
-    caContextCreate::erase(threadId);
+    caContextCreate::erase();
     ca_context_destroy();
 }
 
-typedef std::list<epicsThreadId>::iterator threadListIter;
-
 void caContext::checkContext()
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::checkContext\n");
-    epicsThreadId id = epicsThreadGetIdSelf();
-    if(id==threadId) return;
-    Lock xx(mutex);
-    threadListIter iter = std::find(
-       auxThreadList.begin(),auxThreadList.end(),id);
-    if(iter!=auxThreadList.end()) return;
-    auxThreadList.push_front(id);
+    DBPV_TRACE(caTrace, 2, "caContext::checkContext");
+    // also true in the thread that created the context
+    if(ca_current_context()==context) return;
     SEVCHK(ca_attach_context(context),
         "caContext::checkContext calling ca_context_create");
 }
 
 void caContext::release()
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::release referenceCount %d\n",referenceCount);
-    Lock xx(mutex);
-    referenceCount--;
+    int count = epicsAtomicDecrIntT(&referenceCount);
+    DBPV_TRACE_VALUE(caTrace, 1, "caContext::release referenceCount", count);
 }
 
 void caContext::exception(string const &message)
@@ -123,31 +122,27 @@ void caContext::exception(string const &message)
     else errlogPrintf("caContext exception on dead PVA channel: %s\n", message.c_str());
 }
 
-typedef std::map<epicsThreadId,caContextPtr>::iterator contextMapIter;
-
-std::map<epicsThreadId,caContextPtr>caContextCreate::contextMap;
-Mutex caContextCreate::mutex;
-
 caContextPtr caContextCreate::get(RequesterPtr const &requester)
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::get\n");
-    Lock xx(mutex);
-    epicsThreadId id = epicsThreadGetIdSelf();
-    contextMapIter iter = contextMap.find(id);
-    if(iter!=contextMap.end()) {
-        caContextPtr context = iter->second;
-        context->referenceCount++;
-        return context;
+    DBPV_TRACE(caTrace, 2, "caContext::get");
+    epicsThreadOnce(&contextIdOnce, contextIdInit, 0);
+    caContextPtr *own = static_cast<caContextPtr *>(
+        epicsThreadPrivateGet(contextId));
+    if(own) {
+        epicsAtomicIncrIntT(&(*own)->referenceCount);
+        return *own;
     }
     caContextPtr context(new caContext(requester));
-    contextMap[id] = context;
-    context->referenceCount++;
+    epicsThreadPrivateSet(contextId, new caContextPtr(context));
+    epicsAtomicIncrIntT(&context->referenceCount);
     return context;
 }
 
-void caContextCreate::erase(epicsThreadId threadId)
+void caContextCreate::erase()
 {
-    if(DbPvDebug::getLevel()>0) printf("caContext::erase\n");
-    Lock xx(mutex);
-    contextMap.erase(threadId);
+    DBPV_TRACE(caTrace, 1, "caContext::erase");
+    caContextPtr *own = static_cast<caContextPtr *>(
+        epicsThreadPrivateGet(contextId));
+    epicsThreadPrivateSet(contextId, 0);
+    delete own;
 }
@@ -10,14 +10,14 @@
  * caContextCreate::create and then calls ca_attach_context
  * from checkContext if the caller is a thread that is not the
  * thread that called caContextCreate,create.
+ * The context a thread created is found through thread private
+ * storage, and CA keeps the context a thread is attached to in its
+ * own, so that neither lookup takes a lock.
  */
 
 #ifndef CACONTEXT_H
 #define CACONTEXT_H
 
-#include <map>
-#include <list>
-
 #include <epicsThread.h>
 
 #include <pv/lock.h>
@@ -37,14 +37,13 @@ public:
     void exception(std::string const &message);
     void checkContext();
 private:
-    std::list<epicsThreadId> auxThreadList ;
     epics::pvData::Mutex mutex;
     caContext(
        epics::pvData::RequesterPtr const & requester);
     epics::pvData::Requester::weak_pointer requester;
     epicsThreadId threadId;
     struct ca_client_context *context;
-    int referenceCount;
+    int referenceCount;     // changed atomically
     friend class caContextCreate;
 };
 
@@ -52,9 +51,8 @@ class caContextCreate {
 public:
     static caContextPtr get(epics::pvData::RequesterPtr const & requester);
 private:
-    static void erase(epicsThreadId id);
-    static std::map<epicsThreadId,caContextPtr> contextMap;
-    static epics::pvData::Mutex mutex;
+    /* Forgets the context of the calling thread */
+    static void erase();
     friend class caContext;
 };
 
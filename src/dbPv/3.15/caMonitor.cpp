@@ -23,7 +23,7 @@
 
 #include <pv/caStatus.h>
 
-#include "dbPvDebug.h"
+#include "dbPvTrace.h"
 #include "caMonitor.h"
 #include "caContext.h"
 
@@ -44,7 +44,7 @@ CaData::~CaData()
 class CaMonitorPvt {
 public:
     CaMonitorPvt(CaMonitorRequesterPtr const &requester,
-        string pvName,CaType caType);
+        string pvName,CaType caType,unsigned dbeMask);
     ~CaMonitorPvt();
     CaData & getData();
     void connect();
@@ -54,6 +54,7 @@ public:
     CaMonitorRequesterPtr requester;
     string pvName;
     CaType caType;
+    unsigned dbeMask;
     CaData data;
     chanId chid;
     evid myevid;
@@ -64,7 +65,7 @@ extern "C" {
 
 static void connectionCallback(struct connection_handler_args args)
 {
-    if(DbPvDebug::getLevel()>0) printf("connectionCallback\n");
+    DBPV_TRACE(caTrace, 1, "connectionCallback");
     CaMonitorPvt *pvt = static_cast<CaMonitorPvt *>(ca_puser(args.chid));
     pvt->requester->connectionCallback();
 }
@@ -77,7 +78,7 @@ static void accessRightsCallback(struct access_rights_handler_args args)
 
 static void eventCallback(struct event_handler_args eha)
 {
-    if(DbPvDebug::getLevel()>0) printf("eventCallback\n");
+    DBPV_TRACE(caTrace, 2, "eventCallback");
     CaMonitorPvt *pvt = static_cast<CaMonitorPvt *>(ca_puser(eha.chid));
     if(eha.status!=ECA_NORMAL) {
         pvt->requester->eventCallback(ca_message(eha.status));
@@ -185,25 +186,25 @@ static void eventCallback(struct event_handler_args eha)
             break;
         }
     }
-    if(DbPvDebug::getLevel()>0) printf("eventCallback calling requester->eventCallback\n");
+    DBPV_TRACE(caTrace, 2, "eventCallback calling requester->eventCallback");
     pvt->requester->eventCallback(0);
-    if(DbPvDebug::getLevel()>0) printf("eventCallback after calling requester->eventCallback\n");
+    DBPV_TRACE(caTrace, 2, "eventCallback after calling requester->eventCallback");
 }
 
 } //extern "C"
 
 CaMonitorPvt::CaMonitorPvt(
     CaMonitorRequesterPtr const &requester,
-    string pvName, CaType caType)
-: requester(requester), pvName(pvName), caType(caType),
+    string pvName, CaType caType, unsigned dbeMask)
+: requester(requester), pvName(pvName), caType(caType), dbeMask(dbeMask),
   data(), chid(0), myevid(0), context(caContextCreate::get(requester))
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitorPvt::caMonitorPvt\n");
+    DBPV_TRACE(caTrace, 1, "caMonitorPvt::caMonitorPvt");
 }
 
 CaMonitorPvt::~CaMonitorPvt()
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitorPvt::~caMonitorPvt\n");
+    DBPV_TRACE(caTrace, 1, "caMonitorPvt::~caMonitorPvt");
     if(chid!=0) {
         context->checkContext();
         ca_clear_channel(chid);
@@ -214,7 +215,7 @@ CaMonitorPvt::~CaMonitorPvt()
 
 void CaMonitorPvt::connect()
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitorPvt::connect\n");
+    DBPV_TRACE(caTrace, 1, "caMonitorPvt::connect");
     int status = 0;
     context->checkContext();
     status = ca_create_channel(
@@ -232,7 +233,7 @@ void CaMonitorPvt::connect()
 
 void CaMonitorPvt::start()
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitorPvt::start\n");
+    DBPV_TRACE(caTrace, 1, "caMonitorPvt::start");
     chtype catype = DBR_STRING;
     switch(caType) {
         case CaEnum: catype = DBR_TIME_ENUM; break;
@@ -247,8 +248,11 @@ void CaMonitorPvt::start()
         case CaString: catype = DBR_TIME_STRING; break;
     }
     context->checkContext();
+    // an enum also gets an update when its choices change
+    unsigned long mask = dbeMask;
+    if(caType==CaEnum) mask |= DBE_PROPERTY;
     int status = ca_create_subscription(
-        catype, 1, chid, DBE_VALUE|DBE_ALARM,
+        catype, 1, chid, mask,
         eventCallback, this, &myevid);
     if(status!=ECA_NORMAL) {
         requester->message("ca_create_subscription failed",warningMessage);
@@ -257,22 +261,22 @@ void CaMonitorPvt::start()
 
 void CaMonitorPvt::stop()
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitorPvt::stop\n");
+    DBPV_TRACE(caTrace, 1, "caMonitorPvt::stop");
     context->checkContext();
     ca_clear_subscription(myevid);
 }
 
 CaMonitor::CaMonitor(
     CaMonitorRequesterPtr const &requester,
-    string const &pvName,CaType caType)
-: pImpl(new CaMonitorPvt(requester, pvName, caType))
+    string const &pvName,CaType caType,unsigned dbeMask)
+: pImpl(new CaMonitorPvt(requester, pvName, caType, dbeMask))
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitor::caMonitor\n");
+    DBPV_TRACE(caTrace, 1, "caMonitor::caMonitor");
 }
 
 CaMonitor::~CaMonitor()
 {
-    if(DbPvDebug::getLevel()>0) printf("caMonitor::~caMonitor\n");
+    DBPV_TRACE(caTrace, 1, "caMonitor::~caMonitor");
     delete pImpl;
 }
 
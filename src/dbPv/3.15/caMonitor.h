@@ -66,10 +66,12 @@ typedef std::tr1::shared_ptr<CaMonitorRequester> CaMonitorRequesterPtr;
 
 class CaMonitor : private epics::pvData::NoDefaultMethods {
 public:
+    /* dbeMask is the DBE_XXX events to subscribe to */
     CaMonitor(
         CaMonitorRequesterPtr const &requester,
         std::string const &pvName,
-        CaType caType);
+        CaType caType,
+        unsigned dbeMask);
     ~CaMonitor();
     CaData & getData();
     void connect();
@@ -3,9 +3,16 @@
  * found in the file LICENSE that is included with the distribution.
  */
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include <osiSock.h>
 #include <dbAccess.h>
 #include <epicsStdio.h>
+#include <epicsThread.h>
+#include <callback.h>
 
 #include <db_access_routines.h>
 #include <dbChannel.h>
@@ -15,10 +22,255 @@
 
 #undef epicsExportSharedSymbols
 #include <asDbLib.h>
+#include <pv/lock.h>
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
 using namespace epics::pvaSrv;
+using std::string;
+
+namespace epics { namespace pvaSrv {
+
+// The access security member and level of a channel name.
+// Records, and with them their members, exist for the life of the IOC;
+// an ACF reload moves a member to its new group but keeps it.
+struct AsMember {
+    ASMEMBERPVT memberPvt;
+    int asl;
+};
+
+struct AsClientKey {
+    ASMEMBERPVT memberPvt;
+    int asl;
+    string user;
+    string host;
+    bool operator<(AsClientKey const &other) const
+    {
+        if(memberPvt!=other.memberPvt) return memberPvt<other.memberPvt;
+        if(asl!=other.asl) return asl<other.asl;
+        if(user!=other.user) return user<other.user;
+        return host<other.host;
+    }
+};
+
+struct AsClientEntry {
+    AsClientKey key;
+    ASCLIENTPVT asClientPvt;
+    size_t referenceCount;
+    // the sessions that have a listener
+    std::map<CAServerChannelSecuritySession *,
+        AccessRightsListener::weak_pointer> listeners;
+    // the rights last told to the listeners
+    bool canRead;
+    bool canWrite;
+    bool removed;   // asRemoveClient is due, guarded by notifyMutex
+};
+
+typedef std::map<string, AsMember> AsMemberMap;
+typedef std::map<AsClientKey, AsClientEntry *> AsClientMap;
+
+// Lock order: securityCacheMutex, the asLib lock, notifyMutex.
+// asLib calls clientCallback with its lock held.
+static AsMemberMap memberCache;
+static AsClientMap clientCache;
+static Mutex securityCacheMutex;
+// names that do not exist are not cached, so this only limits the
+// number of different names with filters
+static const size_t maxMemberCacheEntries = 100000;
+
+// the clients whose rights asLib reported, not yet told to listeners
+static std::set<AsClientEntry *> changedClients;
+static bool notifyScheduled = false;
+static CALLBACK notifyCallback;
+static Mutex notifyMutex;
+
+struct RightsChange {
+    AccessRightsListener::shared_pointer listener;
+    bool canRead;
+    bool canWrite;
+};
+
+extern "C" {
+
+static epicsThreadPrivateId listenerScopeId;
+static epicsThreadOnceId securityOnce = EPICS_THREAD_ONCE_INIT;
+
+static void notifyAccessRights(CALLBACK *);
+
+static void securityInit(void *)
+{
+    listenerScopeId = epicsThreadPrivateCreate();
+    callbackSetCallback(notifyAccessRights, &notifyCallback);
+    callbackSetPriority(priorityLow, &notifyCallback);
+}
+
+/* Runs for every client of the IOC after an ACF reload, so it only
+ * queues the client; one callback tells the listeners of all of them.
+ */
+static void clientCallback(ASCLIENTPVT asClientPvt, asClientStatus status)
+{
+    if (status != asClientCOAR) return;
+    AsClientEntry *entry = static_cast<AsClientEntry *>(
+        asGetClientPvt(asClientPvt));
+    if (!entry) return;
+    Lock xx(notifyMutex);
+    if (entry->removed) return;
+    changedClients.insert(entry);
+    if (notifyScheduled) return;
+    notifyScheduled = true;
+    callbackRequest(&notifyCallback);
+}
+
+static void notifyAccessRights(CALLBACK *)
+{
+    std::vector<RightsChange> changes;
+    {
+        // no client is released while its entry is used
+        Lock xx(securityCacheMutex);
+        std::set<AsClientEntry *> changed;
+        {
+            Lock yy(notifyMutex);
+            changed.swap(changedClients);
+            notifyScheduled = false;
+        }
+        for (std::set<AsClientEntry *>::iterator iter = changed.begin();
+             iter != changed.end(); ++iter)
+        {
+            AsClientEntry *entry = *iter;
+            bool canRead = asCheckGet(entry->asClientPvt);
+            bool canWrite = asCheckPut(entry->asClientPvt);
+            if (canRead == entry->canRead && canWrite == entry->canWrite)
+                continue;
+            entry->canRead = canRead;
+            entry->canWrite = canWrite;
+            std::map<CAServerChannelSecuritySession *,
+                AccessRightsListener::weak_pointer>::iterator listener;
+            for (listener = entry->listeners.begin();
+                 listener != entry->listeners.end(); ++listener)
+            {
+                RightsChange change;
+                change.listener = listener->second.lock();
+                change.canRead = canRead;
+                change.canWrite = canWrite;
+                if (change.listener) changes.push_back(change);
+            }
+        }
+    }
+    for (size_t i = 0; i < changes.size(); i++)
+        changes[i].listener->accessRightsChanged(
+            changes[i].canRead, changes[i].canWrite);
+}
+
+} // extern "C"
+
+static bool findMember(string const &channelName, AsMember &member)
+{
+    {
+        Lock xx(securityCacheMutex);
+        AsMemberMap::const_iterator iter = memberCache.find(channelName);
+        if(iter!=memberCache.end()) {
+            member = iter->second;
+            return true;
+        }
+    }
+    struct dbChannel *chan = dbChannel_create(channelName.c_str());
+    if(!chan) return false;
+    member.memberPvt = (ASMEMBERPVT)asDbGetMemberPvt(chan);
+    member.asl = asDbGetAsl(chan);
+    dbChannelDelete(chan);
+    Lock xx(securityCacheMutex);
+    if(memberCache.size()>=maxMemberCacheEntries) memberCache.clear();
+    memberCache[channelName] = member;
+    return true;
+}
+
+static AsClientEntry * acquireClient(
+    AsMember const &member, const char *user, char *host,
+    CAServerChannelSecuritySession *session,
+    AccessRightsListener::weak_pointer const &listener)
+{
+    AsClientKey key;
+    key.memberPvt = member.memberPvt;
+    key.asl = member.asl;
+    key.user = user;
+    key.host = host;
+    Lock xx(securityCacheMutex);
+    AsClientEntry *entry = 0;
+    AsClientMap::iterator iter = clientCache.find(key);
+    if(iter!=clientCache.end()) {
+        entry = iter->second;
+        entry->referenceCount++;
+    } else {
+        entry = new AsClientEntry();
+        entry->key = key;
+        entry->asClientPvt = 0;
+        entry->referenceCount = 1;
+        entry->removed = false;
+        long status = asAddClient(
+                &entry->asClientPvt,
+                member.memberPvt,
+                member.asl,
+                user,
+                host);
+        if (status != 0 && status != S_asLib_asNotActive)
+        {
+            delete entry;
+            throw SecurityException("no room for security table");
+        }
+        entry->canRead = asCheckGet(entry->asClientPvt);
+        entry->canWrite = asCheckPut(entry->asClientPvt);
+        if (entry->asClientPvt) {
+            asPutClientPvt(entry->asClientPvt, entry);
+            asRegisterClientCallback(entry->asClientPvt, clientCallback);
+        }
+        clientCache[key] = entry;
+    }
+    if (!listener.expired()) entry->listeners[session] = listener;
+    return entry;
+}
+
+static void releaseClient(
+    AsClientEntry *entry,
+    CAServerChannelSecuritySession *session)
+{
+    {
+        Lock xx(securityCacheMutex);
+        entry->listeners.erase(session);
+        if(--entry->referenceCount>0) return;
+        clientCache.erase(entry->key);
+        Lock yy(notifyMutex);
+        entry->removed = true;
+        changedClients.erase(entry);
+    }
+    // outside the cache lock, asLib calls back with its own lock held
+    asRemoveClient(&entry->asClientPvt);
+    delete entry;
+}
+
+AccessRightsListenerScope::AccessRightsListenerScope(
+    AccessRightsListener::shared_pointer const & listener)
+: listener(listener)
+{
+    epicsThreadOnce(&securityOnce, securityInit, 0);
+    previous = static_cast<AccessRightsListenerScope *>(
+        epicsThreadPrivateGet(listenerScopeId));
+    epicsThreadPrivateSet(listenerScopeId, this);
+}
+
+AccessRightsListenerScope::~AccessRightsListenerScope()
+{
+    epicsThreadPrivateSet(listenerScopeId, previous);
+}
+
+AccessRightsListener::weak_pointer AccessRightsListenerScope::getCurrent()
+{
+    epicsThreadOnce(&securityOnce, securityInit, 0);
+    AccessRightsListenerScope *scope = static_cast<AccessRightsListenerScope *>(
+        epicsThreadPrivateGet(listenerScopeId));
+    return scope ? scope->listener : AccessRightsListener::weak_pointer();
+}
+
+}}
 
 
 SecuritySession::shared_pointer CAServerSecurityPlugin::createSession(
@@ -55,22 +307,24 @@ Status CAServerChannelSecuritySession::m_noAccessStatus(Status::STATUSTYPE_ERROR
 CAServerChannelSecuritySession::CAServerChannelSecuritySession(std::string const & channelName,
                                const char * user,
                                char * host)
+: m_asClient(0),
+  m_asClientPvt(0)
 {
-    m_dbChannel = dbChannel_create (channelName.c_str());
-    if (!m_dbChannel)
+    AsMember member;
+    if (!findMember(channelName, member))
         throw NoChannelException();
 
-    long status = asAddClient(
-            &m_asClientPvt,
-            (ASMEMBERPVT)asDbGetMemberPvt(m_dbChannel),
-            asDbGetAsl(m_dbChannel),
-            user,
-            host);
-    if (status != 0 && status != S_asLib_asNotActive)
-    {
-        dbChannelDelete(m_dbChannel);
-        throw SecurityException("no room for security table");
-    }
+    AccessRightsListener::weak_pointer listener(
+        AccessRightsListenerScope::getCurrent());
+    m_asClient = acquireClient(member, user, host, this, listener);
+    m_asClientPvt = m_asClient->asClientPvt;
+
+    // the channel was created with all rights
+    AccessRightsListener::shared_pointer strong(listener.lock());
+    bool canRead = asCheckGet(m_asClientPvt);
+    bool canWrite = asCheckPut(m_asClientPvt);
+    if (strong && (!canRead || !canWrite))
+        strong->accessRightsChanged(canRead, canWrite);
 }
 
 CAServerChannelSecuritySession::~CAServerChannelSecuritySession() {
@@ -78,11 +332,11 @@ CAServerChannelSecuritySession::~CAServerChannelSecuritySession() {
 }
 
 void CAServerChannelSecuritySession::close() {
-    if (m_dbChannel)
+    // multiple calls are OK
+    if (m_asClient)
     {
-        dbChannelDelete(m_dbChannel);
-        m_dbChannel = 0;
+        releaseClient(m_asClient, this);
+        m_asClient = 0;
+        m_asClientPvt = 0;
     }
-    // multiple calls are OK
-    asRemoveClient(&m_asClientPvt);
 }
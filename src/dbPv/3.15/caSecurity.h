@@ -29,6 +29,38 @@
 namespace epics {
     namespace pvaSrv {
 
+    // an access security client shared by the sessions of a user and
+    // host for channels of the same member and level
+    struct AsClientEntry;
+
+    /* Told when the access rights of a channel change after it was
+     * created, e.g. by an ACF reload or a change of an INP PV of the
+     * access security group. Called from a callback task.
+     */
+    class epicsShareClass AccessRightsListener
+    {
+    public:
+        POINTER_DEFINITIONS(AccessRightsListener);
+        virtual ~AccessRightsListener() {}
+        virtual void accessRightsChanged(bool canRead, bool canWrite) = 0;
+    };
+
+    /* While in scope, the channel security sessions created by this
+     * thread deliver access rights changes to listener.
+     * pvAccess creates the session of a channel from channelCreated,
+     * so a provider wraps that call.
+     */
+    class epicsShareClass AccessRightsListenerScope
+    {
+    public:
+        explicit AccessRightsListenerScope(
+            AccessRightsListener::shared_pointer const & listener);
+        ~AccessRightsListenerScope();
+        static AccessRightsListener::weak_pointer getCurrent();
+    private:
+        AccessRightsListener::weak_pointer listener;
+        AccessRightsListenerScope *previous;
+    };
 
     class CAServerChannelSecuritySession :
         public epics::pvAccess::ChannelSecuritySession
@@ -162,7 +194,7 @@ namespace epics {
 
         static epics::pvData::Status m_noAccessStatus;
 
-        struct dbChannel *m_dbChannel;
+        AsClientEntry *m_asClient;
         ASCLIENTPVT m_asClientPvt;
     };
 
@@ -0,0 +1,304 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* This subscribes directly to the database event queue of the record
+ * behind a dbChannel, without going through a CA client context.
+ * It provides the same data and callbacks as CaMonitor.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <cstdio>
+
+#include <epicsThread.h>
+#include <dbDefs.h>
+#include <dbAccess.h>
+#include <dbChannel.h>
+#include <dbEvent.h>
+#include <db_field_log.h>
+
+#include <pv/lock.h>
+#include <pv/caStatus.h>
+
+#include "dbPvTrace.h"
+#include "dbEventMonitor.h"
+
+using namespace epics::pvData;
+using std::string;
+using epics::pvAccess::ca::dbrStatus2alarmMessage;
+using epics::pvAccess::ca::dbrStatus2alarmStatus;
+
+namespace epics { namespace pvaSrv {
+
+// All native monitors share a single event task
+dbEventCtx getDbEventContext()
+{
+    static dbEventCtx context = 0;
+    static Mutex mutex;
+    Lock xx(mutex);
+
+    if(context==0) {
+        context = db_init_events();
+        if(context==0) return 0;
+        int status = db_start_events(context, "pvaSrvEvent",
+            NULL, NULL, epicsThreadPriorityCAServerLow);
+        if(status!=DB_EVENT_OK) {
+            db_close_events(context);
+            context = 0;
+        }
+    }
+    return context;
+}
+
+class DbEventMonitorPvt {
+public:
+    DbEventMonitorPvt(CaMonitorRequesterPtr const &requester,
+        dbChannel *dbChan, CaType caType, unsigned dbeMask);
+    ~DbEventMonitorPvt();
+    void connect();
+    void start();
+    void stop();
+    void cancel();
+    void event(db_field_log *pfl);
+    void propertyEvent();
+
+    CaMonitorRequesterPtr requester;
+    dbChannel *dbChan;
+    CaType caType;
+    unsigned dbeMask;
+    CaData data;
+    bool hasData;
+    bool isPropertyEvent;
+    dbEventSubscription evsub;
+    dbEventSubscription propertySub;    // DBE_PROPERTY, except for an enum
+};
+
+extern "C" {
+
+static void dbEventCallback(void *userArg, struct dbChannel *chan,
+    int eventsRemaining, struct db_field_log *pfl)
+{
+    DBPV_TRACE(monitorTrace, 2, "dbEventCallback");
+    DbEventMonitorPvt *pvt = static_cast<DbEventMonitorPvt *>(userArg);
+    pvt->event(pfl);
+}
+
+static void dbPropertyCallback(void *userArg, struct dbChannel *chan,
+    int eventsRemaining, struct db_field_log *pfl)
+{
+    DBPV_TRACE(monitorTrace, 2, "dbPropertyCallback");
+    DbEventMonitorPvt *pvt = static_cast<DbEventMonitorPvt *>(userArg);
+    pvt->propertyEvent();
+}
+
+} //extern "C"
+
+DbEventMonitorPvt::DbEventMonitorPvt(
+    CaMonitorRequesterPtr const &requester,
+    dbChannel *dbChan, CaType caType, unsigned dbeMask)
+: requester(requester), dbChan(dbChan), caType(caType), dbeMask(dbeMask),
+  data(), hasData(false), isPropertyEvent(false), evsub(0), propertySub(0)
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitorPvt::dbEventMonitorPvt");
+}
+
+DbEventMonitorPvt::~DbEventMonitorPvt()
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitorPvt::~dbEventMonitorPvt");
+    cancel();
+}
+
+void DbEventMonitorPvt::cancel()
+{
+    // waits for a callback that is in progress
+    if(evsub!=0) db_cancel_event(evsub);
+    evsub = 0;
+    if(propertySub!=0) db_cancel_event(propertySub);
+    propertySub = 0;
+}
+
+void DbEventMonitorPvt::connect()
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitorPvt::connect");
+    dbEventCtx context = getDbEventContext();
+    if(context==0) {
+        requester->message("db_init_events failed",errorMessage);
+        return;
+    }
+    // an enum also gets an update when its choices change,
+    // other fields get DBE_PROPERTY from a subscription of its own
+    unsigned select = dbeMask&~DBE_PROPERTY;
+    if(caType==CaEnum) select |= DBE_PROPERTY;
+    evsub = db_add_event(context, dbChan, dbEventCallback, this, select);
+    if(evsub==0) {
+        requester->message("db_add_event failed",errorMessage);
+        return;
+    }
+    if(caType!=CaEnum && (dbeMask&DBE_PROPERTY)) {
+        propertySub = db_add_event(context, dbChan,
+            dbPropertyCallback, this, DBE_PROPERTY);
+        if(propertySub==0) {
+            requester->message("db_add_event DBE_PROPERTY failed",
+                warningMessage);
+        }
+    }
+    requester->connectionCallback();
+}
+
+void DbEventMonitorPvt::start()
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitorPvt::start");
+    if(evsub==0) return;
+    db_event_enable(evsub);
+    if(propertySub!=0) db_event_enable(propertySub);
+    // the initial update, as CA would send for a new subscription
+    db_post_single_event(evsub);
+}
+
+void DbEventMonitorPvt::stop()
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitorPvt::stop");
+    if(evsub==0) return;
+    db_event_disable(evsub);
+    if(propertySub!=0) db_event_disable(propertySub);
+}
+
+void DbEventMonitorPvt::event(db_field_log *pfl)
+{
+    // Only scalar fields have their value saved in the field log;
+    // for everything else the record is read by the requester.
+    hasData = false;
+    isPropertyEvent = false;
+    if(pfl && pfl->type==dbfl_type_val) {
+        short fieldType = pfl->field_type;
+        const union native_value *from = &pfl->u.v.field;
+        switch(caType) {
+        case CaEnum:
+            if(fieldType==DBF_ENUM || fieldType==DBF_MENU
+            || fieldType==DBF_DEVICE) {
+                data.intValue = from->dbf_enum;
+                hasData = true;
+            }
+            break;
+        case CaByte:
+            if(fieldType==DBF_CHAR) {
+                data.byteValue = from->dbf_char;
+                hasData = true;
+            }
+            break;
+        case CaUByte:
+            if(fieldType==DBF_UCHAR) {
+                data.ubyteValue = from->dbf_uchar;
+                hasData = true;
+            }
+            break;
+        case CaShort:
+            if(fieldType==DBF_SHORT) {
+                data.shortValue = from->dbf_short;
+                hasData = true;
+            }
+            break;
+        case CaUShort:
+            if(fieldType==DBF_USHORT) {
+                data.ushortValue = from->dbf_ushort;
+                hasData = true;
+            }
+            break;
+        case CaInt:
+            if(fieldType==DBF_LONG) {
+                data.intValue = from->dbf_long;
+                hasData = true;
+            }
+            break;
+        case CaUInt:
+            if(fieldType==DBF_ULONG) {
+                data.uintValue = from->dbf_ulong;
+                hasData = true;
+            }
+            break;
+        case CaFloat:
+            if(fieldType==DBF_FLOAT) {
+                data.floatValue = from->dbf_float;
+                hasData = true;
+            }
+            break;
+        case CaDouble:
+            if(fieldType==DBF_DOUBLE) {
+                data.doubleValue = from->dbf_double;
+                hasData = true;
+            }
+            break;
+        case CaString:
+            // client will get value from record
+            break;
+        }
+        if(hasData) {
+            data.sevr = pfl->sevr;
+            data.stat = dbrStatus2alarmStatus[pfl->stat];
+            data.status = dbrStatus2alarmMessage[pfl->stat];
+            data.timeStamp = pfl->time;
+        }
+    }
+    requester->eventCallback(0);
+}
+
+// Both subscriptions are served by the single event task
+void DbEventMonitorPvt::propertyEvent()
+{
+    hasData = false;
+    isPropertyEvent = true;
+    requester->eventCallback(0);
+}
+
+DbEventMonitor::DbEventMonitor(
+    CaMonitorRequesterPtr const &requester,
+    dbChannel *dbChan, CaType caType, unsigned dbeMask)
+: pImpl(new DbEventMonitorPvt(requester, dbChan, caType, dbeMask))
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitor::dbEventMonitor");
+}
+
+DbEventMonitor::~DbEventMonitor()
+{
+    DBPV_TRACE(monitorTrace, 1, "dbEventMonitor::~dbEventMonitor");
+    delete pImpl;
+}
+
+CaData * DbEventMonitor::getData()
+{
+    return pImpl->hasData ? &pImpl->data : 0;
+}
+
+bool DbEventMonitor::isPropertyEvent()
+{
+    return pImpl->isPropertyEvent;
+}
+
+void DbEventMonitor::connect()
+{
+    pImpl->connect();
+}
+
+void DbEventMonitor::start()
+{
+    pImpl->start();
+}
+
+void DbEventMonitor::stop()
+{
+    pImpl->stop();
+}
+
+void DbEventMonitor::cancel()
+{
+    pImpl->cancel();
+}
+
+bool DbEventMonitor::isConnected()
+{
+    return pImpl->evsub!=0;
+}
+
+}}
@@ -0,0 +1,57 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* This subscribes directly to the database event queue of the record
+ * behind a dbChannel, without going through a CA client context.
+ * It provides the same data and callbacks as CaMonitor.
+ */
+
+#ifndef DBEVENTMONITOR_H
+#define DBEVENTMONITOR_H
+
+#include <dbChannel.h>
+#include <dbEvent.h>
+
+#include <pv/noDefaultMethods.h>
+
+#include "caMonitor.h"
+
+namespace epics { namespace pvaSrv {
+
+/* The event context of the single event task that all database
+ * subscriptions of pvaSrv share. Returns 0 if it can not be started.
+ */
+dbEventCtx getDbEventContext();
+
+class DbEventMonitor : private epics::pvData::NoDefaultMethods {
+public:
+    /* dbeMask is the DBE_XXX events to subscribe to */
+    DbEventMonitor(
+        CaMonitorRequesterPtr const &requester,
+        dbChannel *dbChan,
+        CaType caType,
+        unsigned dbeMask);
+    ~DbEventMonitor();
+    /* Returns the data of the last event or 0 if the event did not
+     * carry a value snapshot, in which case the record must be read.
+     */
+    CaData * getData();
+    /* True if the last event was only DBE_PROPERTY, after which only
+     * the display, control and valueAlarm data need to be read.
+     * An enum gets the choices with a full event.
+     */
+    bool isPropertyEvent();
+    void connect();
+    void start();
+    void stop();
+    /* Removes the subscription, waiting for a callback in progress */
+    void cancel();
+    bool isConnected();
+private:
+    class DbEventMonitorPvt *pImpl;
+};
+
+}}
+
+#endif  /* DBEVENTMONITOR_H */
@@ -26,35 +26,48 @@ using std::string;
 
 namespace epics { namespace pvaSrv { 
 
-static int dbPvDebugLevel = 0;
+// sets the trace level of all subsystems
 void DbPvDebug::setLevel(int level)
 {
-    dbPvDebugLevel = level;
+    for(int i=0; i<DbPvTrace::numberSubsystems; i++) {
+        DbPvTrace::setLevel(static_cast<DbPvTrace::Subsystem>(i), level);
+    }
 }
 
 int DbPvDebug::getLevel()
 {
-    return dbPvDebugLevel;
+    int level = 0;
+    for(int i=0; i<DbPvTrace::numberSubsystems; i++) {
+        int subsystemLevel =
+            DbPvTrace::getLevel(static_cast<DbPvTrace::Subsystem>(i));
+        if(subsystemLevel>level) level = subsystemLevel;
+    }
+    return level;
 }
 
-DbPv::DbPv(
+DbPvShare::DbPvShare(
     DbPvProviderPtr const &provider,
-    ChannelRequester::shared_pointer const & requester,
     string const &name,
     dbChannel *dbChan
 )
 :  provider(provider),
-   requester(requester),
    name(name),
    dbChan(dbChan),
    recordField()
 {
-//printf("dbPv::dbPv\n");
+    DBPV_TRACE(channelTrace, 1, "dbPvShare::dbPvShare");
+    createRecordField();
 }
 
-void DbPv::init()
+DbPvShare::~DbPvShare()
+{
+    DBPV_TRACE(channelTrace, 1, "dbPvShare::~dbPvShare");
+    provider->removeShare(name);
+    dbChannelDelete(dbChan);
+}
+
+void DbPvShare::createRecordField()
 {
-    // this requires valid existance of dbPv::shared_pointer instance
     StandardFieldPtr standardField = getStandardField();
     ScalarType scalarType = pvBoolean;
     switch(dbChannelFinalFieldType(dbChan)) {
@@ -110,14 +123,53 @@ void DbPv::init()
     }
 }
 
+// Adds operation, dropping the destroyed ones
+template<class T>
+static void addOperation(
+    std::vector<std::tr1::weak_ptr<T> > &operations,
+    std::tr1::shared_ptr<T> const &operation)
+{
+    size_t used = 0;
+    for(size_t i=0; i<operations.size(); i++) {
+        if(operations[i].expired()) continue;
+        operations[used++] = operations[i];
+    }
+    operations.resize(used);
+    operations.push_back(operation);
+}
+
+DbPv::DbPv(
+    DbPvProviderPtr const &provider,
+    ChannelRequester::shared_pointer const & requester,
+    string const &name,
+    DbPvSharePtr const &share
+)
+:  provider(provider),
+   requester(requester),
+   name(name),
+   share(share),
+   canRead(true),
+   canWrite(true)
+{
+//printf("dbPv::dbPv\n");
+}
+
 DbPv::~DbPv()
 {
 //printf("dbPv::~dbPv\n");
 }
 
+PutCoalescer::shared_pointer DbPv::getPutCoalescer()
+{
+    Lock xx(mutex);
+    if(!putCoalescer) putCoalescer.reset(new PutCoalescer(getDbChannel()));
+    return putCoalescer;
+}
+
 void DbPv::getField(GetFieldRequester::shared_pointer const &requester,
         string const &subField)
 {
+    FieldConstPtr recordField = share->getRecordField();
     if(recordField) {
         requester->getDone(Status::Ok,recordField);
         return;
@@ -164,7 +216,15 @@ ChannelPut::shared_pointer DbPv::createChannelPut(
             createFailed,
             dbPvPut,
             nullStructure);
+        return dbPvPut;
+    }
+    bool write;
+    {
+        Lock xx(mutex);
+        addOperation(puts, dbPvPut);
+        write = canWrite;
     }
+    if(!write) dbPvPut->accessRightsChanged(false);
     return dbPvPut;
 }
 
@@ -181,7 +241,15 @@ Monitor::shared_pointer DbPv::createMonitor(
             createFailed,
             dbPvMonitor,
             xxx);
+        return dbPvMonitor;
     }
+    bool read;
+    {
+        Lock xx(mutex);
+        addOperation(monitors, dbPvMonitor);
+        read = canRead;
+    }
+    if(!read) dbPvMonitor->accessRightsChanged(false);
     return dbPvMonitor;
 }
 
@@ -202,6 +270,32 @@ ChannelArray::shared_pointer DbPv::createChannelArray(
     return dbPvArray;
 }
 
+void DbPv::accessRightsChanged(bool canRead, bool canWrite)
+{
+    DBPV_TRACE_VALUE(channelTrace, 1, "dbPv::accessRightsChanged canRead", canRead);
+    std::vector<DbPvMonitor::shared_pointer> liveMonitors;
+    std::vector<DbPvPut::shared_pointer> livePuts;
+    {
+        Lock xx(mutex);
+        this->canRead = canRead;
+        this->canWrite = canWrite;
+        for(size_t i=0; i<monitors.size(); i++) {
+            DbPvMonitor::shared_pointer monitor(monitors[i].lock());
+            if(monitor) liveMonitors.push_back(monitor);
+        }
+        for(size_t i=0; i<puts.size(); i++) {
+            DbPvPut::shared_pointer put(puts[i].lock());
+            if(put) livePuts.push_back(put);
+        }
+    }
+    for(size_t i=0; i<liveMonitors.size(); i++) {
+        liveMonitors[i]->accessRightsChanged(canRead);
+    }
+    for(size_t i=0; i<livePuts.size(); i++) {
+        livePuts[i]->accessRightsChanged(canWrite);
+    }
+}
+
 void DbPv::printInfo(std::ostream& out)
 {
     out << "dbPv provides access to DB records";
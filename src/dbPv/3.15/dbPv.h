@@ -9,31 +9,52 @@
 #ifndef DBPV_H
 #define DBPV_H
 
+#include <string>
+#include <map>
+#include <vector>
+
 #include <dbAccess.h>
 #include <dbChannel.h>
 #include <dbNotify.h>
+#include <epicsAtomic.h>
+#include <epicsTimer.h>
 
 #include <pv/thread.h>
 #include <pv/event.h>
 #include <pv/pvAccess.h>
 
 #include "caMonitor.h"
+#include "caSecurity.h"
+#include "monitorElementQueue.h"
+#include "arraySnapshotPool.h"
 #include "dbPvDebug.h"
+#include "dbPvTrace.h"
+#include "dbRecordData.h"
+#include "dbPvStats.h"
+#include "notifyPool.h"
+#include "putCoalescer.h"
 
 namespace epics { namespace pvaSrv { 
 
 class DbUtil;
 typedef std::tr1::shared_ptr<DbUtil> DbUtilPtr;
+class DbAccessPlan;
+typedef std::tr1::shared_ptr<DbAccessPlan> DbAccessPlanPtr;
 
 class DbPvProvider;
 typedef std::tr1::shared_ptr<DbPvProvider> DbPvProviderPtr;
 class DbPv;
 typedef std::tr1::shared_ptr<DbPv> DbPvPtr;
+class DbPvShare;
+typedef std::tr1::shared_ptr<DbPvShare> DbPvSharePtr;
 class DbPvProcess;
 class DbPvGet;
 class DbPvPut;
 class DbPvMonitor;
 class DbPvArray;
+class DbEventMonitor;
+class MonitorShare;
+class RecordNameIndex;
 
 typedef struct dbAddr DbAddr;
 typedef std::vector<DbAddr> DbAddrArray;
@@ -65,18 +86,57 @@ public:
         epics::pvAccess::ChannelRequester::shared_pointer  const &channelRequester,
         short priority,
         std::string const &address);
+    /* Called after iocInit, when the set of records is final */
+    void createNameIndex();
+    /* Returns 0 before createNameIndex */
+    const RecordNameIndex * getNameIndex();
 private:
     shared_pointer getPtrSelf()
     {
         return shared_from_this();
     }
     DbPvProvider();
+    /* Returns the share of channelName, or one of its own
+     * if the channel has filters, which keep state per dbChannel.
+     * Returns null after telling channelRequester why.
+     */
+    DbPvSharePtr getShare(
+        std::string const &channelName,
+        epics::pvAccess::ChannelRequester::shared_pointer const &channelRequester);
+    void removeShare(std::string const &channelName);
     epics::pvAccess::ChannelFind::shared_pointer channelFinder;
+    EpicsAtomicPtrT nameIndex;  // RecordNameIndex, set once
+    // the channels without filters by name
+    std::map<std::string,std::tr1::weak_ptr<DbPvShare> > shares;
+    epics::pvData::Mutex sharesMutex;
     friend DbPvProviderPtr getDbPvProvider();
+    friend class DbPvShare;
+};
+
+/* The dbChannel and introspection interface of a channel name,
+ * shared by the DbPv of every client of that name.
+ */
+class DbPvShare {
+public:
+    POINTER_DEFINITIONS(DbPvShare);
+    DbPvShare(
+        DbPvProviderPtr const & provider,
+        std::string const & name,
+        dbChannel *dbChan);
+    ~DbPvShare();
+    dbChannel * getDbChannel() { return dbChan; }
+    epics::pvData::FieldConstPtr getRecordField() { return recordField; }
+private:
+    void createRecordField();
+    DbPvProviderPtr provider;
+    std::string name;
+    dbChannel *dbChan;
+    epics::pvData::FieldConstPtr recordField;
 };
 
 class DbPv :
     public virtual epics::pvAccess::Channel,
+    public virtual AccessRightsListener,
     public std::tr1::enable_shared_from_this<DbPv>
 {
 public:
@@ -85,10 +145,9 @@ public:
         DbPvProviderPtr const & provider,
         epics::pvAccess::ChannelRequester::shared_pointer const & requester,
         std::string const & name,
-        dbChannel *dbChan
+        DbPvSharePtr const & share
         );
     virtual ~DbPv();
-    void init();
     virtual void destroy(){}
     virtual epics::pvAccess::ChannelProvider::shared_pointer getProvider()
        { return provider;}
@@ -120,7 +179,15 @@ public:
         epics::pvAccess::ChannelArrayRequester::shared_pointer const &channelArrayRequester,
         epics::pvData::PVStructurePtr const &pvRequest);
     virtual void printInfo(std::ostream& out);
-    struct dbChannel * getDbChannel() { return dbChan; }
+    struct dbChannel * getDbChannel() { return share->getDbChannel(); }
+    /* The latest value slot of the coalescing puts of this client,
+     * created on first use
+     */
+    PutCoalescer::shared_pointer getPutCoalescer();
+    /* Revokes or restores reading of the monitors and writing of the
+     * puts of this channel.
+     */
+    virtual void accessRightsChanged(bool canRead, bool canWrite);
 private:
     shared_pointer getPtrSelf()
     {
@@ -129,11 +196,18 @@ private:
     DbPvProviderPtr  provider;
     requester_type::weak_pointer requester;
     std::string name;
-    dbChannel *dbChan;
-    epics::pvData::FieldConstPtr recordField;
+    DbPvSharePtr share;
+    // declared after share, its processNotify refers to the dbChannel
+    PutCoalescer::shared_pointer putCoalescer;
     epics::pvData::PVStructurePtr pvNullStructure;
     epics::pvData::BitSetPtr emptyBitSet;
     epics::pvData::StructureConstPtr nullStructure;
+    // the operations told about access rights changes
+    std::vector<std::tr1::weak_ptr<DbPvMonitor> > monitors;
+    std::vector<std::tr1::weak_ptr<DbPvPut> > puts;
+    bool canRead;
+    bool canWrite;
+    epics::pvData::Mutex mutex;
 };
 
 class DbPvProcess :
@@ -176,6 +250,7 @@ private:
     std::string fieldListString;
     std::string valueString;
     std::tr1::shared_ptr<struct processNotify> pNotify;
+    DbPvTimer notifyTimer;
     epics::pvData::Mutex mutex;
     bool beingDestroyed;
 };
@@ -214,12 +289,14 @@ private:
     DbPvPtr dbPv;
     requester_type::weak_pointer channelGetRequester;
     epics::pvData::PVStructurePtr pvStructure;
+    DbAccessPlanPtr accessPlan;
+    DbRecordData recordData;    // read with the record locked
     epics::pvData::BitSet::shared_pointer bitSet;
     bool process;
     bool block;
     bool firstTime;
     int propertyMask;
-    std::tr1::shared_ptr<struct processNotify> pNotify;
+    NotifyPool notifyPool;
     epics::pvData::Event event;
     epics::pvData::Mutex dataMutex;
     epics::pvData::Mutex mutex;
@@ -229,6 +306,7 @@ private:
 
 class DbPvPut :
   public virtual epics::pvAccess::ChannelPut,
+  public virtual PutCoalescerRequester,
   public std::tr1::enable_shared_from_this<DbPvPut>
 {
 public:
@@ -253,23 +331,40 @@ public:
     virtual void get();
     virtual void lock();
     virtual void unlock();
+    virtual epics::pvData::Status coalescedPut(
+        epics::pvData::PVStructurePtr const &pvStructure);
+    virtual epics::pvData::Status coalescedPutNotify(
+        epics::pvData::PVStructurePtr const &pvStructure,
+        notifyPutType type);
+    virtual void coalescedPutDone(epics::pvData::Status const &status);
+    /* Puts not yet applied fail while writing is revoked */
+    void accessRightsChanged(bool canWrite);
 private:
     shared_pointer getPtrSelf()
     {
         return shared_from_this();
     }
+    epics::pvData::Status putNow(epics::pvData::PVStructurePtr const &pvStructure);
+    epics::pvData::Status putLocked(
+        epics::pvData::PVStructurePtr const &pvStructure,
+        notifyPutType type);
     static int putCallback(struct processNotify *pn, notifyPutType type);
     static void doneCallback(struct processNotify *pn);
     DbUtilPtr dbUtil;
     DbPvPtr dbPv;
     requester_type::weak_pointer channelPutRequester;
     epics::pvData::PVStructurePtr pvStructure;
+    DbAccessPlanPtr putPlan;
+    DbAccessPlanPtr getPlan;  // for the structure last put
+    DbRecordData recordData;  // read with the record locked
     epics::pvData::BitSet::shared_pointer bitSet;
     int propertyMask;
     bool process;
     bool block;
+    bool coalesce;  // record._options.coalesce=true
+    int writeAllowed;   // epicsAtomic
     bool firstTime;
-    std::tr1::shared_ptr<struct processNotify> pNotify;
+    NotifyPool notifyPool;
     epics::pvData::Mutex dataMutex;
     epics::pvData::Mutex mutex;
     epics::pvData::Status status;
@@ -279,6 +374,7 @@ private:
 class DbPvMonitor
 : public virtual epics::pvData::Monitor,
   public virtual CaMonitorRequester,
+  public epicsTimerNotify,
   public std::tr1::enable_shared_from_this<DbPvMonitor>
 {
 public:
@@ -304,13 +400,40 @@ public:
     virtual void eventCallback(const char *);
     virtual void lock();
     virtual void unlock();
+    /* Stops the monitor while reading is revoked; a monitor that was
+     * started is started again, with a full update, when it is restored.
+     */
+    void accessRightsChanged(bool canRead);
+    /* Called by MonitorShare with the data converted for all its clients
+     * and the fields changed by the event.
+     */
+    void sharedEvent(
+        epics::pvData::PVStructurePtr const & pvShared,
+        epics::pvData::BitSet const & changedBitSet);
+    /* Sends the update held back by maxRate */
+    virtual expireStatus expire(const epicsTime & currentTime);
 private:
     shared_pointer getPtrSelf()
     {
         return shared_from_this();
     }
+    void initFilters(
+        requester_type::shared_pointer const & req,
+        epics::pvData::PVStructurePtr const & pvRequest);
+    void queueCurrent(requester_type::shared_pointer const & req);
+    /* false if the changes in current are held back */
+    bool filterPasses(
+        epics::pvData::PVStructure const & pvStructure,
+        epics::pvData::BitSet const & changed);
+    void markStale(epics::pvData::BitSet const & changed, size_t except);
+    epicsUInt64 monotonicNow();
+    // what to do with an update while the queue is full
+    enum OverflowPolicy {
+        squashOverflow,     // merge into the newest queued element
+        dropOldestOverflow, // discard the oldest queued element
+        dropNewestOverflow  // hold back for the next event
+    };
     DbUtilPtr dbUtil;
-    epics::pvData::MonitorElementPtr &getFree();
     DbPvPtr dbPv;
     requester_type::weak_pointer  monitorRequester;
     epics::pvData::Event event;
@@ -319,18 +442,40 @@ private:
     bool gotEvent;
     CaType caType;
     int queueSize;
+    OverflowPolicy overflowPolicy;
+    unsigned dbeMask;   // record._options.DBE
     std::tr1::shared_ptr<CaMonitor> caMonitor;
-    int numberFree;
-    int numberUsed;
-    int nextGetFree;
-    int nextGetUsed;
-    int nextReleaseUsed;
+    std::vector<DbAccessPlanPtr> accessPlans;  // per element, for caMonitor
+    DbRecordData recordData;
+    std::tr1::shared_ptr<MonitorShare> share;
     epics::pvData::Mutex mutex;
     bool beingDestroyed;
     bool isStarted;
+    bool readAllowed;
+    bool restartOnAccess;   // was started when reading was revoked
     epics::pvData::MonitorElementPtrArray elements;
-    epics::pvData::MonitorElementPtr currentElement;
+    MonitorElementQueue queue;
+    // per element, the fields that differ from the current element
+    std::vector<epics::pvData::BitSet::shared_pointer> staleBitSets;
+    ArraySnapshotPool arrayPool;
     epics::pvData::MonitorElementPtr nullElement;
+    // record._options.deadband and maxRate
+    enum DeadbandType { noDeadband, absoluteDeadband, relativeDeadband };
+    DeadbandType deadbandType;
+    double deadband;                // relative as a fraction
+    size_t valueOffset;
+    epics::pvData::BitSet deadbandFields;   // value and timeStamp
+    double lastValue;               // of the last update sent
+    epicsUInt64 minPeriod;          // ns, 0 without maxRate
+    epicsUInt64 lastTime;           // when the last update was sent
+    epicsUInt64 lastClock;          // of monotonicNow
+    epicsUInt64 clockOffset;
+    epicsTimerQueueActive *timerQueue;
+    epicsTimer *rateTimer;          // of maxRate
+    bool timerStarted;
+    bool expiring;
+    // serializes the producer, the event task and the maxRate timer
+    epics::pvData::Mutex producerMutex;
 };
 
 class DbPvArray :
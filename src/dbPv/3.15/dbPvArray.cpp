@@ -49,6 +49,7 @@
 #define epicsExportSharedSymbols
 #include <epicsExport.h>
 #include "dbPv.h"
+#include "arrayCopy.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -78,6 +79,35 @@ typedef long (*get_array_info) (DBADDR *,long *,long *);
 typedef long (*put_array_info) (DBADDR *,long );
 }
 
+// start is the index of the first element in the record buffer,
+// which may be circular
+template<typename T>
+static void getArrayElements(
+        PVScalarArrayPtr const &pvScalarArray,
+        dbChannel *dbChan,
+        size_t start, size_t count, size_t stride)
+{
+    shared_vector<T> xxx(count);
+    const T *from = static_cast<const T *>(dbChannelField(dbChan));
+    gatherRingElements(xxx.data(), from, dbChannelElements(dbChan),
+        start, count, stride);
+    shared_vector<const T> data(freeze(xxx));
+    static_pointer_cast<PVValueArray<T> >(pvScalarArray)->replace(data);
+}
+
+template<typename T>
+static void putArrayElements(
+        PVArray::shared_pointer const &pvArray,
+        dbChannel *dbChan,
+        size_t offset, size_t count, size_t stride)
+{
+    shared_vector<const T> xxx(
+        static_pointer_cast<PVValueArray<T> >(pvArray)->view());
+    if (count > xxx.size()) count = xxx.size();
+    T *to = static_cast<T *>(dbChannelField(dbChan));
+    scatterElements(to + offset, xxx.data(), count, stride);
+}
+
 DbPvArray::DbPvArray(
         DbPvPtr const &dbPv,
         ChannelArrayRequester::shared_pointer const &channelArrayRequester)
@@ -85,12 +115,12 @@ DbPvArray::DbPvArray(
       channelArrayRequester(channelArrayRequester),
       beingDestroyed(false)
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvArray::dbPvArray\n");
+    DBPV_TRACE(arrayTrace, 1, "dbPvArray::dbPvArray");
 }
 
 DbPvArray::~DbPvArray()
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvArray::~dbPvArray\n");
+    DBPV_TRACE(arrayTrace, 1, "dbPvArray::~dbPvArray");
 }
 
 bool DbPvArray::init(PVStructure::shared_pointer const &pvRequest)
@@ -139,8 +169,7 @@ bool DbPvArray::init(PVStructure::shared_pointer const &pvRequest)
 }
 
 void DbPvArray::destroy() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvArray::destroy beingDestroyed %s\n",
-                                       (beingDestroyed ? "true" : "false"));
+    DBPV_TRACE_VALUE(arrayTrace, 1, "dbPvArray::destroy beingDestroyed", beingDestroyed);
     {
         Lock xx(mutex);
         if(beingDestroyed) return;
@@ -161,16 +190,6 @@ void DbPvArray::getArray(size_t offset,
         get_array_info get_info;
         get_info = (get_array_info)(prset->get_array_info);
         get_info(&dbPv->getDbChannel()->addr, &alength, &aoffset);
-        if (aoffset != 0) {
-            dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
-            Status status(Status::STATUSTYPE_ERROR,
-                          "array offset not supported");
-            if(req) req->getArrayDone(
-                        status,
-                        getPtrSelf(),
-                        nullPVArray);
-            return;
-        }
     }
     bool ok = false;
     while (true) {
@@ -196,89 +215,43 @@ void DbPvArray::getArray(size_t offset,
                     pvScalarArray);
         return;
     }
-    size_t capacity = pvScalarArray->getCapacity();
+    dbChannel *dbChan = dbPv->getDbChannel();
+    // a circular buffer starts at aoffset
+    size_t start = aoffset + offset;
     {
         Lock lock(dataMutex);
-        switch (dbChannelFinalFieldType(dbPv->getDbChannel())) {
-        case DBF_CHAR: {
-            shared_vector<int8> xxx(capacity);
-            int8 *from = static_cast<int8 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const int8> data(freeze(xxx));
-            PVByteArrayPtr pva = static_pointer_cast<PVByteArray>(pvScalarArray);
-            pva->replace(data);
+        switch (dbChannelFinalFieldType(dbChan)) {
+        case DBF_CHAR:
+            getArrayElements<int8>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_UCHAR: {
-            shared_vector<uint8> xxx(count);
-            uint8 *from = static_cast<uint8 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const uint8> data(freeze(xxx));
-            PVUByteArrayPtr pva = static_pointer_cast<PVUByteArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_UCHAR:
+            getArrayElements<uint8>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_SHORT: {
-            shared_vector<int16> xxx(count);
-            int16 *from = static_cast<int16 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const int16> data(freeze(xxx));
-            PVShortArrayPtr pva = static_pointer_cast<PVShortArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_SHORT:
+            getArrayElements<int16>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_USHORT: {
-            shared_vector<uint16> xxx(count);
-            uint16 *from = static_cast<uint16 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const uint16> data(freeze(xxx));
-            PVUShortArrayPtr pva = static_pointer_cast<PVUShortArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_USHORT:
+            getArrayElements<uint16>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_LONG: {
-            shared_vector<int32> xxx(count);
-            int32 *from = static_cast<int32 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const int32> data(freeze(xxx));
-            PVIntArrayPtr pva = static_pointer_cast<PVIntArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_LONG:
+            getArrayElements<int32>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_ULONG: {
-            shared_vector<uint32> xxx(count);
-            uint32 *from = static_cast<uint32 *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const uint32> data(freeze(xxx));
-            PVUIntArrayPtr pva = static_pointer_cast<PVUIntArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_ULONG:
+            getArrayElements<uint32>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_FLOAT: {
-            shared_vector<float> xxx(count);
-            float *from = static_cast<float *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const float> data(freeze(xxx));
-            PVFloatArrayPtr pva = static_pointer_cast<PVFloatArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_FLOAT:
+            getArrayElements<float>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
-        case DBF_DOUBLE: {
-            shared_vector<double> xxx(count);
-            double *from = static_cast<double *>(dbChannelField(dbPv->getDbChannel()));
-            for(size_t i= 0;i< count; ++i) xxx[i] = from[i*stride+offset];
-            shared_vector<const double> data(freeze(xxx));
-            PVDoubleArrayPtr pva = static_pointer_cast<PVDoubleArray>(pvScalarArray);
-            pva->replace(data);
+        case DBF_DOUBLE:
+            getArrayElements<double>(pvScalarArray, dbChan, start, count, stride);
             break;
-        }
         case DBF_STRING: {
             shared_vector<string> xxx(count);
-            char *from = static_cast<char *>(dbChannelField(dbPv->getDbChannel()));
-            from += offset * dbChannelFinalFieldSize(dbPv->getDbChannel());
+            char *from = static_cast<char *>(dbChannelField(dbChan));
+            size_t size = dbChannelFinalFieldSize(dbChan);
+            size_t capacity = dbChannelElements(dbChan);
             for(size_t i= 0;i< count; ++i) {
-                xxx[i] = from;
-                from += stride * dbChannelFinalFieldSize(dbPv->getDbChannel());
+                xxx[i] = from + ((start + i*stride)%capacity)*size;
             }
             shared_vector<const string> data(freeze(xxx));
             PVStringArrayPtr pva = static_pointer_cast<PVStringArray>(pvScalarArray);
@@ -330,67 +303,34 @@ void DbPvArray::putArray(
             }
         }
     }
+    dbChannel *dbChan = dbPv->getDbChannel();
     {
         Lock lock(dataMutex);
-        switch (dbChannelFinalFieldType(dbPv->getDbChannel())) {
-        case DBF_CHAR: {
-            PVByteArrayPtr pva = static_pointer_cast<PVByteArray>(pvArray);
-            shared_vector<const int8> xxx(pva->view());
-            int8 *to = static_cast<int8 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        switch (dbChannelFinalFieldType(dbChan)) {
+        case DBF_CHAR:
+            putArrayElements<int8>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_UCHAR: {
-            PVUByteArrayPtr pva = static_pointer_cast<PVUByteArray>(pvArray);
-            shared_vector<const uint8> xxx(pva->view());
-            uint8 *to = static_cast<uint8 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_UCHAR:
+            putArrayElements<uint8>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_SHORT: {
-            PVShortArrayPtr pva = static_pointer_cast<PVShortArray>(pvArray);
-            shared_vector<const int16> xxx(pva->view());
-            int16 *to = static_cast<int16 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_SHORT:
+            putArrayElements<int16>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_USHORT: {
-            PVUShortArrayPtr pva = static_pointer_cast<PVUShortArray>(pvArray);
-            shared_vector<const uint16> xxx(pva->view());
-            uint16 *to = static_cast<uint16 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_USHORT:
+            putArrayElements<uint16>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_LONG: {
-            PVIntArrayPtr pva = static_pointer_cast<PVIntArray>(pvArray);
-            shared_vector<const int32> xxx(pva->view());
-            int32 *to = static_cast<int32 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_LONG:
+            putArrayElements<int32>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_ULONG: {
-            PVUIntArrayPtr pva = static_pointer_cast<PVUIntArray>(pvArray);
-            shared_vector<const uint32> xxx(pva->view());
-            uint32 *to = static_cast<uint32 *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_ULONG:
+            putArrayElements<uint32>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_FLOAT: {
-            PVFloatArrayPtr pva = static_pointer_cast<PVFloatArray>(pvArray);
-            shared_vector<const float> xxx(pva->view());
-            float *to = static_cast<float *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) to[i*stride + offset] = xxx[i];
+        case DBF_FLOAT:
+            putArrayElements<float>(pvArray, dbChan, offset, count, stride);
             break;
-        }
-        case DBF_DOUBLE: {
-            PVDoubleArrayPtr pva = static_pointer_cast<PVDoubleArray>(pvArray);
-            shared_vector<const double> xxx(pva->view());
-            double *to = static_cast<double *>(dbChannelField(dbPv->getDbChannel()));
-            for (size_t i = 0; i < count; i++) {
-                to[i*stride + offset] = xxx[i];
-            }
+        case DBF_DOUBLE:
+            putArrayElements<double>(pvArray, dbChan, offset, count, stride);
             break;
-        }
         case DBF_STRING: {
             PVStringArrayPtr pva = static_pointer_cast<PVStringArray>(pvArray);
             shared_vector<const string> xxx(pva->view());
@@ -23,6 +23,7 @@
 
 #include "dbPv.h"
 #include "dbUtil.h"
+#include "dbPvStats.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -42,12 +43,12 @@ DbPvGet::DbPvGet(
   propertyMask(0),
   beingDestroyed(false)
 {
-    if(DbPvDebug::getLevel()>0)printf("dbPvGet::dbPvGet\n");
+    DBPV_TRACE(getTrace, 1, "dbPvGet::dbPvGet");
 }
 
 DbPvGet::~DbPvGet()
 {
-    if(DbPvDebug::getLevel()>0)printf("dbPvGet::~dbPvGet\n");
+    DBPV_TRACE(getTrace, 1, "dbPvGet::~dbPvGet");
 }
 
 bool DbPvGet::init(PVStructure::shared_pointer const &pvRequest)
@@ -66,18 +67,25 @@ bool DbPvGet::init(PVStructure::shared_pointer const &pvRequest)
                     dbPv->getDbChannel(),
                     pvRequest));
     if (!pvStructure.get()) return false;
+    accessPlan = dbUtil->createAccessPlan(
+        req,
+        propertyMask,
+        dbPv->getDbChannel(),
+        pvStructure);
     int numFields = pvStructure->getNumberFields();
     bitSet.reset(new BitSet(numFields));
     if (propertyMask & dbUtil->processBit) {
         process = true;
-        pNotify.reset(new (struct processNotify)());
-        struct processNotify *pn = pNotify.get();
-        pn->chan = dbPv->getDbChannel();
-        pn->requestType = processGetRequest;
-        pn->getCallback  = this->getCallback;
-        pn->doneCallback = this->doneCallback;
-        pn->usrPvt = this;
-        if (propertyMask & dbUtil->blockBit) block = true;
+        if (propertyMask & dbUtil->blockBit) {
+            block = true;
+            notifyPool.init(
+                dbPv->getDbChannel(),
+                processGetRequest,
+                0,
+                this->getCallback,
+                this->doneCallback,
+                this);
+        }
     }
     if(req) req->channelGetConnect(
                 Status::Ok,
@@ -98,37 +106,38 @@ void DbPvGet::message(string const &message,MessageType messageType)
 }
 
 void DbPvGet::destroy() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvGet::destroy beingDestroyed %s\n",
-         (beingDestroyed ? "true" : "false"));
+    DBPV_TRACE_VALUE(getTrace, 1, "dbPvGet::destroy beingDestroyed", beingDestroyed);
     {
         Lock xx(mutex);
         if(beingDestroyed) return;
         beingDestroyed = true;
-        if (pNotify) dbNotifyCancel(pNotify.get());
     }
+    if (block) notifyPool.cancel();
 }
 
 void DbPvGet::get()
 {
-    if (DbPvDebug::getLevel()>0) printf("dbPvGet::get()\n");
+    DBPV_TRACE(getTrace, 2, "dbPvGet::get()");
+    DbPvStats::increment(DbPvStats::getCounter);
     if (block && process) {
-        dbProcessNotify(pNotify.get());
+        notifyPool.request(PVStructurePtr(), BitSetPtr());
     } else {
         requester_type::shared_pointer req(channelGetRequester.lock());
 
+        Lock lock(dataMutex);
         dbScanLock(dbChannelRecord(dbPv->getDbChannel()));
+        DbPvTimer timer;
         if (process) dbProcess(dbChannelRecord(dbPv->getDbChannel()));
-
-        Lock lock(dataMutex);
+        dbUtil->readRecord(*accessPlan, recordData, 0);
+        dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+        timer.lap(DbPvStats::getLockHistogram);
         bitSet->clear();
         status = dbUtil->get(
                     req,
-                    propertyMask,
-                    dbPv->getDbChannel(),
-                    pvStructure,
+                    *accessPlan,
                     bitSet,
-                    0);
-        dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+                    recordData);
+        timer.stop(DbPvStats::getConvertHistogram);
         if (firstTime) {
             firstTime = false;
             bitSet->clear();
@@ -145,40 +154,46 @@ void DbPvGet::get()
 
 void DbPvGet::getCallback(struct processNotify *pn, notifyGetType type)
 {
-    DbPvGet * pdp = static_cast<DbPvGet *>(pn->usrPvt);
+    NotifyPool::Request *request = NotifyPool::getRequest(pn);
+    DbPvGet * pdp = static_cast<DbPvGet *>(request->owner);
 
     if (pn->status == notifyCanceled) {
-        if (DbPvDebug::getLevel() > 0) printf("dbPvGet::getCallback notifyCanceled\n");
+        DBPV_TRACE(getTrace, 2, "dbPvGet::getCallback notifyCanceled");
         return;
     }
+    // the record is locked, it is converted in doneCallback
+    pdp->dbUtil->readRecord(*pdp->accessPlan, request->recordData, 0);
+}
+
+void DbPvGet::doneCallback(struct processNotify *pn)
+{
+    NotifyPool::Request *request = NotifyPool::getRequest(pn);
+    DbPvGet * pdp = static_cast<DbPvGet *>(request->owner);
+    DbPvGet::shared_pointer self(pdp->getPtrSelf());
+
+    request->timer.stop(DbPvStats::notifyHistogram);
+    requester_type::shared_pointer req(pdp->channelGetRequester.lock());
     Lock lock(pdp->dataMutex);
+    DbPvTimer timer;
     pdp->bitSet->clear();
     pdp->status = pdp->dbUtil->get(
-                pdp->channelGetRequester.lock(),
-                pdp->propertyMask,
-                pdp->dbPv->getDbChannel(),
-                pdp->pvStructure,
+                req,
+                *pdp->accessPlan,
                 pdp->bitSet,
-                0);
+                request->recordData);
+    timer.stop(DbPvStats::getConvertHistogram);
     if (pdp->firstTime) {
         pdp->firstTime = false;
         pdp->bitSet->clear();
         pdp->bitSet->set(0);
     }
     lock.unlock();
-    if (!pdp->status.isSuccess()) pn->status = notifyError;
-}
-
-void DbPvGet::doneCallback(struct processNotify *pn)
-{
-    DbPvGet * pdp = static_cast<DbPvGet *>(pn->usrPvt);
-
-    requester_type::shared_pointer req(pdp->channelGetRequester.lock());
     if(req) req->getDone(
                 pdp->status,
-                pdp->getPtrSelf(),
+                self,
                 pdp->pvStructure,
                 pdp->bitSet);
+    pdp->notifyPool.release(request, self);
 }
 
 void DbPvGet::lock()
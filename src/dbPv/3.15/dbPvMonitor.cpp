@@ -13,16 +13,21 @@
 #include <cstddef>
 #include <cstdlib>
 #include <cstddef>
+#include <cmath>
 #include <string>
 #include <cstdio>
 #include <stdexcept>
 #include <memory>
 
 #include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsTimer.h>
+#include <epicsVersion.h>
 
 #include <dbAccess.h>
 #include <dbNotify.h>
 #include <dbCommon.h>
+#include <caeventmask.h>
 
 #include <pv/pvData.h>
 #include <pv/convert.h>
@@ -35,17 +40,46 @@
 #include "dbPv.h"
 #include "caContext.h"
 #include "caMonitor.h"
+#include "monitorShare.h"
 #include "dbUtil.h"
+#include "dbPvStats.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
 using std::tr1::dynamic_pointer_cast;
+using std::tr1::static_pointer_cast;
 using namespace std;
 
+// Set non-zero to monitor through a CA client context instead of
+// subscribing to the database event queue directly.
+extern "C" {
+    int dbPvUseCaMonitor = 0;
+    epicsExportAddress(int, dbPvUseCaMonitor);
+}
+
 namespace epics { namespace pvaSrv { 
 
 static ConvertPtr convert = getConvert();
 
+// Copy the fields set in changed; the bit of a structure copies all of it
+static void copyChanged(
+    PVStructurePtr const & from,
+    PVStructurePtr const & to,
+    BitSet const & changed)
+{
+    int32 offset = changed.nextSetBit(0);
+    if(offset==0) {
+        convert->copy(from,to);
+        return;
+    }
+    while(offset>=0) {
+        PVFieldPtr pvFrom = from->getSubField(offset);
+        PVFieldPtr pvTo = to->getSubField(offset);
+        convert->copy(pvFrom,pvTo);
+        offset = changed.nextSetBit(pvFrom->getNextFieldOffset());
+    }
+}
+
 DbPvMonitor::DbPvMonitor(
     DbPvPtr const &dbPv,
     MonitorRequester::shared_pointer const &monitorRequester)
@@ -58,20 +92,36 @@ DbPvMonitor::DbPvMonitor(
   gotEvent(false),
   caType(CaByte),
   queueSize(2),
+  overflowPolicy(dropNewestOverflow),
+  dbeMask(DBE_VALUE|DBE_ALARM),
   caMonitor(),
-  numberFree(queueSize),
-  numberUsed(0),
-  nextGetFree(0),
-  nextGetUsed(0),
-  nextReleaseUsed(0),
+  share(),
   beingDestroyed(false),
-  isStarted(false)
+  isStarted(false),
+  readAllowed(true),
+  restartOnAccess(false),
+  deadbandType(noDeadband),
+  deadband(0.0),
+  valueOffset(0),
+  lastValue(0.0),
+  minPeriod(0),
+  lastTime(0),
+  lastClock(0),
+  clockOffset(0),
+  timerQueue(0),
+  rateTimer(0),
+  timerStarted(false),
+  expiring(false)
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvMonitor::dbPvMonitor\n");
+    DBPV_TRACE(monitorTrace, 1, "dbPvMonitor::dbPvMonitor");
 }
 
 DbPvMonitor::~DbPvMonitor() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvMonitor::~dbPvMonitor\n");
+    DBPV_TRACE(monitorTrace, 1, "dbPvMonitor::~dbPvMonitor");
+    if(rateTimer) {
+        rateTimer->destroy();
+        timerQueue->release();
+    }
 }
 
 bool DbPvMonitor::init(
@@ -84,7 +134,54 @@ bool DbPvMonitor::init(
         if(pvString) {
              string value = pvString->get();
              queueSize = atoi(value.c_str());
-             numberFree = queueSize;
+             // the producer always owns one element
+             if(queueSize<2) queueSize = 2;
+        }
+    }
+    string overflowString("record._options.overflow");
+    {
+        PVStringPtr pvString = pvRequest.get()->getSubField<PVString>(overflowString);
+        if(pvString) {
+             string value = pvString->get();
+             if(value=="squash") {
+                 overflowPolicy = squashOverflow;
+             } else if(value=="dropOldest") {
+                 overflowPolicy = dropOldestOverflow;
+             } else if(value=="dropNewest") {
+                 overflowPolicy = dropNewestOverflow;
+             } else if(req) {
+                 req->message("unknown overflow policy " + value
+                     + " using dropNewest", warningMessage);
+             }
+        }
+    }
+    string dbeString("record._options.DBE");
+    {
+        PVStringPtr pvString = pvRequest.get()->getSubField<PVString>(dbeString);
+        if(pvString) {
+             // e.g. VALUE|ALARM, the default
+             string value = pvString->get();
+             unsigned mask = 0;
+             size_t start = 0;
+             while(start<=value.size()) {
+                 size_t end = value.find_first_of("|,", start);
+                 if(end==string::npos) end = value.size();
+                 string name = value.substr(start, end-start);
+                 if(name=="VALUE") {
+                     mask |= DBE_VALUE;
+                 } else if(name=="ARCHIVE" || name=="LOG") {
+                     mask |= DBE_LOG;
+                 } else if(name=="ALARM") {
+                     mask |= DBE_ALARM;
+                 } else if(name=="PROPERTY") {
+                     mask |= DBE_PROPERTY;
+                 } else if(req) {
+                     req->message("unknown DBE event " + name
+                         + " ignored", warningMessage);
+                 }
+                 start = end+1;
+             }
+             if(mask!=0) dbeMask = mask;
         }
     }
     propertyMask = dbUtil->getProperties(
@@ -108,6 +205,18 @@ bool DbPvMonitor::init(
         MonitorElementPtr element(new MonitorElement(pvStructure));
         elements.push_back(element);
     }
+    queue.setElements(elements);
+    staleBitSets.reserve(queueSize);
+    for(int i=0; i<queueSize; i++) {
+        size_t numberFields = elements[i]->pvStructurePtr->getNumberFields();
+        BitSet::shared_pointer stale(new BitSet(numberFields));
+        // nothing has been copied into the elements yet
+        stale->set(0);
+        staleBitSets.push_back(stale);
+    }
+    initFilters(req, pvRequest);
+    // every element may hold a snapshot, plus the one being filled
+    if(propertyMask&dbUtil->arrayValueBit) arrayPool.setCapacity(queueSize+1);
     MonitorElementPtr element = elements[0];
     StructureConstPtr saveStructure = element->pvStructurePtr->getStructure();
     if((propertyMask&dbUtil->enumValueBit)!=0) {
@@ -130,11 +239,31 @@ bool DbPvMonitor::init(
             throw std::logic_error("bad scalarType");
         }
     }
-    string pvName = dbPv->getChannelName();
-    caMonitor.reset(
-        new CaMonitor(getPtrSelf(), pvName, caType));
-    caMonitor->connect();
-    event.wait();
+    if(dbPvUseCaMonitor) {
+        string pvName = dbPv->getChannelName();
+        accessPlans.reserve(queueSize);
+        for(int i=0; i<queueSize; i++) {
+            accessPlans.push_back(dbUtil->createAccessPlan(
+                req,
+                propertyMask,
+                dbPv->getDbChannel(),
+                elements[i]->pvStructurePtr));
+        }
+        caMonitor.reset(
+            new CaMonitor(getPtrSelf(), pvName, caType, dbeMask));
+        caMonitor->connect();
+        event.wait();
+    } else {
+        share = MonitorShare::attach(
+            getPtrSelf(),
+            dbPv->getChannelName(),
+            propertyMask,
+            dbeMask,
+            caType,
+            queueSize,
+            element->pvStructurePtr);
+        if(!share) return false;
+    }
     Monitor::shared_pointer thisPointer = dynamic_pointer_cast<Monitor>(getPtrSelf());
     if(req) req->monitorConnect(
        Status::Ok,
@@ -143,6 +272,73 @@ bool DbPvMonitor::init(
     return true;
 }
 
+void DbPvMonitor::initFilters(
+    requester_type::shared_pointer const & req,
+    PVStructurePtr const & pvRequest)
+{
+    PVStructurePtr pvStructure = elements[0]->pvStructurePtr;
+    PVStringPtr pvOption = pvRequest->getSubField<PVString>(
+        "record._options.deadband");
+    if(pvOption) {
+        // abs:<delta> or rel:<percent>[%]
+        string value = pvOption->get();
+        size_t colon = value.find(':');
+        string kind = value.substr(0, colon);
+        const char *number = colon==string::npos ? "" : value.c_str()+colon+1;
+        char *end = 0;
+        double delta = strtod(number, &end);
+        bool valid = end!=number && delta>=0.0;
+        if(valid && kind=="abs" && *end==0) {
+            deadbandType = absoluteDeadband;
+            deadband = delta;
+        } else if(valid && kind=="rel" && (*end==0 || string(end)=="%")) {
+            deadbandType = relativeDeadband;
+            deadband = delta/100.0;
+        } else if(req) {
+            req->message("bad deadband " + value
+                + " expected abs:<delta> or rel:<percent>%", warningMessage);
+        }
+        PVScalarPtr pvValue = pvStructure->getSubField<PVScalar>("value");
+        ScalarType scalarType = pvString;
+        if(pvValue) scalarType = pvValue->getScalar()->getScalarType();
+        if(deadbandType!=noDeadband
+        && (scalarType==pvString || scalarType==pvBoolean)) {
+            deadbandType = noDeadband;
+            if(req) req->message(
+                "deadband needs a numeric scalar value, ignored",
+                warningMessage);
+        }
+        if(deadbandType!=noDeadband) {
+            // changes of only these are subject to the deadband
+            valueOffset = pvValue->getFieldOffset();
+            deadbandFields.set(valueOffset);
+            PVFieldPtr pvTimeStamp = pvStructure->getSubField("timeStamp");
+            if(pvTimeStamp) {
+                for(size_t i=pvTimeStamp->getFieldOffset();
+                    i<pvTimeStamp->getNextFieldOffset(); i++) {
+                    deadbandFields.set(i);
+                }
+            }
+        }
+    }
+    pvOption = pvRequest->getSubField<PVString>("record._options.maxRate");
+    if(pvOption) {
+        // <rate>[Hz]
+        string value = pvOption->get();
+        char *end = 0;
+        double rate = strtod(value.c_str(), &end);
+        if(end!=value.c_str() && rate>0.0
+        && (*end==0 || string(end)=="Hz")) {
+            minPeriod = static_cast<epicsUInt64>(1e9/rate);
+            timerQueue = &epicsTimerQueueActive::allocate(true);
+            rateTimer = &timerQueue->createTimer();
+        } else if(req) {
+            req->message("bad maxRate " + value
+                + " expected a positive rate in Hz", warningMessage);
+        }
+    }
+}
+
 string DbPvMonitor::getRequesterName() {
     requester_type::shared_pointer req(monitorRequester.lock());
     return req ? req->getRequesterName() : "<DEAD>";
@@ -155,41 +351,53 @@ void DbPvMonitor::message(string const &message,MessageType messageType)
 }
 
 void DbPvMonitor::destroy() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvMonitor::destroy beingDestroyed %s\n",
-         (beingDestroyed ? "true" : "false"));
+    DBPV_TRACE_VALUE(monitorTrace, 1, "dbPvMonitor::destroy beingDestroyed", beingDestroyed);
     {
         Lock xx(mutex);
         if(beingDestroyed) return;
         beingDestroyed = true;
     }
     stop();
+    epicsTimer *oldTimer = 0;
+    {
+        // an event past its beingDestroyed check no longer starts it
+        Lock xx(producerMutex);
+        oldTimer = rateTimer;
+        rateTimer = 0;
+    }
+    if(oldTimer) {
+        // waits for expire to return, which needs producerMutex
+        oldTimer->destroy();
+        timerQueue->release();
+        timerQueue = 0;
+    }
+    if(share) share->detach(this);
     caMonitor.reset();
+    share.reset();
     dbPv.reset();
 }
 
 Status DbPvMonitor::start()
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvMonitor::start\n");
+    DBPV_TRACE(monitorTrace, 1, "dbPvMonitor::start");
     {
+        // firstTime belongs to the producer, producerMutex is taken first
+        Lock pp(producerMutex);
         Lock xx(mutex);
         if(beingDestroyed) {
              Status status(Status::STATUSTYPE_ERROR,"beingDestroyed");
              return status;
         }
+        if(!readAllowed) {
+             Status status(Status::STATUSTYPE_ERROR,"no read access");
+             return status;
+        }
         if(isStarted) return Status::Ok;
         isStarted = true;
         firstTime = true;
     }
-    if(!currentElement) {
-        currentElement = getFree();
-    }
-    if(!currentElement) {
-        printf("dbPvMonitor::start will throw\n");
-        throw std::logic_error(
-            "dbPvMonitor::start no free queue element");
-    }
-
-    caMonitor.get()->start();
+    if(caMonitor) caMonitor->start();
+    else share->start(this);
     return Status::Ok;
 }
 
@@ -197,38 +405,28 @@ Status DbPvMonitor::stop()
 {
     {
         Lock xx(mutex);
+        restartOnAccess = false;
         if (!isStarted) return Status::Ok;
         isStarted = false;
     }
-    if (DbPvDebug::getLevel() > 0) printf("dbPvMonitor::stop\n");
-    caMonitor->stop();
+    DBPV_TRACE(monitorTrace, 1, "dbPvMonitor::stop");
+    if(caMonitor) caMonitor->stop();
+    else share->stop(this);
     return Status::Ok;
 }
 
 MonitorElementPtr DbPvMonitor::poll()
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvMonitor::poll\n");
+    DBPV_TRACE(monitorTrace, 2, "dbPvMonitor::poll");
     if (beingDestroyed) return nullElement;
-    Lock xx(mutex);
-    if (numberUsed == 0) return nullElement;
-    int ind = nextGetUsed;
-    nextGetUsed++;
-    if (nextGetUsed >= queueSize) nextGetUsed = 0;
-    return elements[ind];
+    return queue.poll();
 }
 
 void DbPvMonitor::release(MonitorElementPtr const & element)
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvMonitor::release\n");
+    DBPV_TRACE(monitorTrace, 2, "dbPvMonitor::release");
     if (beingDestroyed) return;
-    Lock xx(mutex);
-    if (element != elements[nextReleaseUsed++]) {
-        throw std::logic_error(
-                    "not queueElement returned by last call to getUsed");
-    }
-    if (nextReleaseUsed >= queueSize) nextReleaseUsed = 0;
-    numberUsed--;
-    numberFree++;
+    queue.release(element);
 }
 
 void DbPvMonitor::exceptionCallback(long status,long op)
@@ -236,35 +434,96 @@ void DbPvMonitor::exceptionCallback(long status,long op)
 
 void DbPvMonitor::connectionCallback()
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvMonitor::connectionCallback\n");
+    DBPV_TRACE(monitorTrace, 1, "dbPvMonitor::connectionCallback");
     event.signal();
 }
 
 void DbPvMonitor::accessRightsCallback()
 {}
 
+void DbPvMonitor::accessRightsChanged(bool canRead)
+{
+    DBPV_TRACE_VALUE(monitorTrace, 1, "dbPvMonitor::accessRightsChanged canRead", canRead);
+    bool wasStarted = false;
+    bool restart = false;
+    {
+        Lock xx(mutex);
+        if(beingDestroyed || readAllowed==canRead) return;
+        readAllowed = canRead;
+        if(canRead) {
+            restart = restartOnAccess;
+            restartOnAccess = false;
+        } else {
+            wasStarted = isStarted;
+            restartOnAccess = isStarted;
+            isStarted = false;
+        }
+    }
+    if(!canRead) {
+        if(wasStarted) {
+            if(caMonitor) caMonitor->stop();
+            else share->stop(this);
+        }
+        message("read access revoked, monitor stopped", warningMessage);
+        return;
+    }
+    message("read access restored", infoMessage);
+    if(restart) start();
+}
+
 void DbPvMonitor::eventCallback(const char *status)
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvMonitor::eventCallback\n");
+    DBPV_TRACE(monitorTrace, 2, "dbPvMonitor::eventCallback");
     if(beingDestroyed) return;
     requester_type::shared_pointer req(monitorRequester.lock());
     if(status!=0) {
          if(req) req->message(status, errorMessage);
     }
-    MonitorElementPtr nextElement = nullElement;
-    PVStructure::shared_pointer pvStructure = currentElement->pvStructurePtr;
-    BitSet::shared_pointer bitSet = currentElement->changedBitSet;
+    Lock xx(producerMutex);
+    MonitorElementPtr const & currentElement = queue.getCurrent();
+    DbAccessPlan const &plan = *accessPlans[queue.getCurrentIndex()];
     dbScanLock(dbChannelRecord(dbPv->getDbChannel()));
-    CaData &caData = caMonitor.get()->getData();
-    BitSet::shared_pointer overrunBitSet = currentElement->overrunBitSet;
+    DbPvTimer timer;
+    dbUtil->readRecord(plan, recordData, &caMonitor->getData(), &arrayPool);
+    dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+    timer.lap(DbPvStats::monitorLockHistogram);
     Status stat = dbUtil->get(
        req,
-       propertyMask,
-       dbPv->getDbChannel(),
-       pvStructure,
-       overrunBitSet,
-       &caData);
+       plan,
+       currentElement->overrunBitSet,
+       recordData);
+    timer.stop(DbPvStats::monitorConvertHistogram);
+    queueCurrent(req);
+}
 
+void DbPvMonitor::sharedEvent(
+    PVStructurePtr const & pvShared,
+    BitSet const & changedBitSet)
+{
+    DBPV_TRACE(monitorTrace, 2, "dbPvMonitor::sharedEvent");
+    if(beingDestroyed) return;
+    requester_type::shared_pointer req(monitorRequester.lock());
+    Lock xx(producerMutex);
+    if(!firstTime && changedBitSet.nextSetBit(0)<0) return;
+    MonitorElementPtr const & currentElement = queue.getCurrent();
+    if(firstTime) {
+        convert->copy(pvShared,currentElement->pvStructurePtr);
+    } else {
+        copyChanged(pvShared,currentElement->pvStructurePtr,changedBitSet);
+    }
+    *currentElement->overrunBitSet |= changedBitSet;
+    queueCurrent(req);
+}
+
+// The changes of the last event are in the overrunBitSet of current
+void DbPvMonitor::queueCurrent(requester_type::shared_pointer const & req)
+{
+    MonitorElementPtr const & currentElement = queue.getCurrent();
+    MonitorElementPtr nextElement = nullElement;
+    PVStructure::shared_pointer pvStructure = currentElement->pvStructurePtr;
+    BitSet::shared_pointer bitSet = currentElement->changedBitSet;
+    BitSet::shared_pointer overrunBitSet = currentElement->overrunBitSet;
+    bool sendAll = firstTime;
     if(firstTime) {
         firstTime = false;
         bitSet->clear();
@@ -281,39 +540,180 @@ void DbPvMonitor::eventCallback(const char *status)
             index = overrunBitSet->nextSetBit(index+1);
         }
     }
-    
+
+    // held back changes stay in current until an update passes, which
+    // is why the filters test current and not the data before the copy
+    if((deadbandType!=noDeadband || minPeriod>0)
+    && bitSet->nextSetBit(0)>=0) {
+        if(!sendAll && !filterPasses(*pvStructure,*bitSet)) return;
+        if(deadbandType!=noDeadband) {
+            lastValue = convert->toDouble(static_pointer_cast<PVScalar>(
+                pvStructure->getSubField(valueOffset)));
+        }
+        if(minPeriod>0) lastTime = monotonicNow();
+    }
+    MonitorElementPtr lastElement = nullElement;
     if(bitSet->nextSetBit(0)>=0) {
-        nextElement =getFree();
+        nextElement = queue.getNext();
+        if(!nextElement && overflowPolicy==dropOldestOverflow) {
+            MonitorElementPtr const & oldElement = queue.dropOldest();
+            if(oldElement) {
+                // changes only seen by the dropped element are sent now,
+                // fields it and current both changed are overrun
+                BitSet::shared_pointer oldBitSet = oldElement->changedBitSet;
+                int index = oldBitSet->nextSetBit(0);
+                while(index>=0) {
+                    if(bitSet->get(index)) overrunBitSet->set(index);
+                    index = oldBitSet->nextSetBit(index+1);
+                }
+                *overrunBitSet |= *oldElement->overrunBitSet;
+                *bitSet |= *oldBitSet;
+                nextElement = queue.getNext();
+                DbPvStats::increment(DbPvStats::monitorDropOldestCounter);
+            }
+        }
         if(nextElement) {
-            PVStructure::shared_pointer pvNext = nextElement->pvStructurePtr;
-            convert->copy(pvStructure,pvNext);
+            // array values are frozen snapshots, which copy only shares
+            size_t nextIndex = queue.getNextIndex();
+            BitSet::shared_pointer stale = staleBitSets[nextIndex];
+            *stale |= *bitSet;
+            copyChanged(pvStructure,nextElement->pvStructurePtr,*stale);
+            stale->clear();
+            markStale(*bitSet,nextIndex);
             nextElement->changedBitSet->clear();
             nextElement->overrunBitSet->clear();
+        } else if(overflowPolicy!=dropNewestOverflow) {
+            // the consumer may just have taken the newest element,
+            // in that case the update is held back as for dropNewest
+            lastElement = queue.reclaimLast();
+        }
+        if(!nextElement && !lastElement) {
+            DbPvStats::increment(DbPvStats::monitorDropNewestCounter);
+        }
+        if(lastElement) {
+            DbPvStats::increment(DbPvStats::monitorSquashCounter);
+            BitSet::shared_pointer lastBitSet = lastElement->changedBitSet;
+            BitSet::shared_pointer lastOverrunBitSet = lastElement->overrunBitSet;
+            int index = bitSet->nextSetBit(0);
+            while(index>=0) {
+                if(lastBitSet->get(index)) {
+                    lastOverrunBitSet->set(index);
+                } else {
+                    lastBitSet->set(index);
+                }
+                index = bitSet->nextSetBit(index+1);
+            }
+            *lastOverrunBitSet |= *overrunBitSet;
+            // last was equal to current except for the changes in bitSet
+            size_t lastIndex = queue.getLastIndex();
+            copyChanged(pvStructure,lastElement->pvStructurePtr,*bitSet);
+            markStale(*bitSet,lastIndex);
+            bitSet->clear();
+            overrunBitSet->clear();
         }
     }
-    dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
-    if(bitSet->nextSetBit(0)<0) return;
-    if(!nextElement) return;
-    numberUsed++;
-    currentElement = nextElement;
+    if(lastElement) {
+        queue.requeueLast();
+    } else {
+        if(bitSet->nextSetBit(0)<0) return;
+        if(!nextElement) return;
+        queue.publish();
+    }
+    DbPvStats::increment(DbPvStats::monitorEventCounter);
+    if(DbPvStats::isEnabled()) {
+        DbPvStats::add(DbPvStats::monitorQueueHistogram, queue.getNumberUsed());
+    }
     if(req) req->monitorEvent(getPtrSelf());
 }
 
-void DbPvMonitor::lock()
-{}
+bool DbPvMonitor::filterPasses(
+    PVStructure const & pvStructure,
+    BitSet const & changed)
+{
+    if(deadbandType!=noDeadband) {
+        bool onlyValue = true;
+        int32 index = changed.nextSetBit(0);
+        while(index>=0) {
+            if(!deadbandFields.get(index)) {
+                onlyValue = false;
+                break;
+            }
+            index = changed.nextSetBit(index+1);
+        }
+        if(onlyValue) {
+            double value = convert->toDouble(static_pointer_cast<PVScalar>(
+                pvStructure.getSubField(valueOffset)));
+            double limit = deadbandType==absoluteDeadband ?
+                deadband : deadband*fabs(lastValue);
+            if(fabs(value-lastValue)<=limit) return false;
+        }
+    }
+    if(minPeriod>0 && !expiring) {
+        // the timer is gone once destroy has started
+        if(!rateTimer) return false;
+        epicsUInt64 elapsed = monotonicNow()-lastTime;
+        if(elapsed<minPeriod) {
+            if(!timerStarted) {
+                timerStarted = true;
+                rateTimer->start(*this, (minPeriod-elapsed)/1e9);
+            }
+            return false;
+        }
+    }
+    return true;
+}
 
-void DbPvMonitor::unlock()
-{}
+epicsTimerNotify::expireStatus DbPvMonitor::expire(const epicsTime & currentTime)
+{
+    DBPV_TRACE(monitorTrace, 2, "dbPvMonitor::expire");
+    requester_type::shared_pointer req(monitorRequester.lock());
+    Lock xx(producerMutex);
+    timerStarted = false;
+    {
+        // no one takes producerMutex while holding mutex
+        Lock yy(mutex);
+        if(beingDestroyed || !isStarted) return expireStatus(noRestart);
+    }
+    expiring = true;
+    queueCurrent(req);
+    expiring = false;
+    return expireStatus(noRestart);
+}
 
-MonitorElementPtr &DbPvMonitor::getFree()
+// Nanoseconds that never go backwards, for maxRate.
+// Before 3.16.1 there is no monotonic clock, a step back of the
+// wall clock is added to clockOffset instead.
+epicsUInt64 DbPvMonitor::monotonicNow()
 {
-    if(numberFree==0) return nullElement;
-    numberFree--;
-    int ind = nextGetFree;
-    nextGetFree++;
-    if(nextGetFree>=queueSize) nextGetFree = 0;
-    return elements[ind];
+#if EPICS_VERSION>3 || (EPICS_VERSION==3 && (EPICS_REVISION>16 \
+    || (EPICS_REVISION==16 && EPICS_MODIFICATION>=1)))
+    return epicsMonotonicGet();
+#else
+    epicsTimeStamp stamp;
+    epicsTimeGetCurrent(&stamp);
+    epicsUInt64 clock =
+        static_cast<epicsUInt64>(stamp.secPastEpoch)*1000000000u + stamp.nsec;
+    if(clock+clockOffset<lastClock) clockOffset = lastClock-clock;
+    lastClock = clock+clockOffset;
+    return lastClock;
+#endif
+}
 
+// Elements other than current and except no longer have the fields
+// in changed that current has.
+void DbPvMonitor::markStale(BitSet const & changed, size_t except)
+{
+    size_t currentIndex = queue.getCurrentIndex();
+    for(size_t i=0; i<staleBitSets.size(); i++) {
+        if(i==currentIndex || i==except) continue;
+        *staleBitSets[i] |= changed;
+    }
 }
 
+void DbPvMonitor::lock()
+{}
+
+void DbPvMonitor::unlock()
+{}
+
 }}
@@ -23,6 +23,7 @@
 
 #include "dbPv.h"
 #include "dbUtil.h"
+#include "dbPvStats.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -43,12 +44,12 @@ DbPvProcess::DbPvProcess(
   valueString("value"),
   beingDestroyed(false)
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvProcess::dbPvProcess\n");
+    DBPV_TRACE(processTrace, 1, "dbPvProcess::dbPvProcess");
 }
 
 DbPvProcess::~DbPvProcess()
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvProcess::~dbPvProcess\n");
+    DBPV_TRACE(processTrace, 1, "dbPvProcess::~dbPvProcess");
 }
 
 bool DbPvProcess::init(epics::pvData::PVStructurePtr const & pvRequest)
@@ -84,8 +85,7 @@ void DbPvProcess::message(string const &message,MessageType messageType)
 }
 
 void DbPvProcess::destroy() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvProcess::destroy beingDestroyed %s\n",
-         (beingDestroyed ? "true" : "false"));
+    DBPV_TRACE_VALUE(processTrace, 1, "dbPvProcess::destroy beingDestroyed", beingDestroyed);
     {
         Lock xx(mutex);
         if (beingDestroyed) return;
@@ -97,6 +97,7 @@ void DbPvProcess::destroy() {
 void DbPvProcess::process()
 {
     if (block) {
+        notifyTimer.start();
         dbProcessNotify(pNotify.get());
     } else {
         dbScanLock(dbChannelRecord(dbPv->getDbChannel()));
@@ -108,6 +109,7 @@ void DbPvProcess::process()
 void DbPvProcess::notifyCallback(struct processNotify *pn)
 {
     DbPvProcess * pdp = static_cast<DbPvProcess *>(pn->usrPvt);
+    pdp->notifyTimer.stop(DbPvStats::notifyHistogram);
     requester_type::shared_pointer req(pdp->channelProcessRequester.lock());
     if(req) req->processDone(Status::Ok, pdp->getPtrSelf());
 }
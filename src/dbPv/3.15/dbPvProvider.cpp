@@ -18,6 +18,7 @@
 #include <epicsExit.h>
 #include <dbAccess.h>
 #include <dbStaticLib.h>
+#include <initHooks.h>
 
 #include <pv/serverContext.h>
 #include <pv/syncChannelFind.h>
@@ -29,6 +30,7 @@
 #define epicsExportSharedSymbols
 #include "dbPv.h"
 #include "caSecurity.h"
+#include "recordNameIndex.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -40,6 +42,7 @@ namespace epics { namespace pvaSrv {
 static string providerName("dbPv");
 
 DbPvProvider::DbPvProvider()
+: nameIndex(0)
 {
 //printf("dbPvProvider::dbPvProvider\n");
 }
@@ -83,6 +86,12 @@ private:
 };
 
 
+static void dbPvInitHook(initHookState state)
+{
+    if(state!=initHookAfterIocRunning) return;
+    getDbPvProvider()->createNameIndex();
+}
+
 DbPvProviderPtr getDbPvProvider()
 {
     static DbPvProviderPtr dbPvProvider;
@@ -96,6 +105,7 @@ DbPvProviderPtr getDbPvProvider()
         ChannelProvider::shared_pointer xxx = dynamic_pointer_cast<ChannelProvider>(dbPvProvider);
         dbPvProvider->channelFinder = SyncChannelFind::shared_pointer(new SyncChannelFind(xxx));
         DbPvProviderFactory::create(dbPvProvider);
+        initHookRegister(dbPvInitHook);
     }
     return dbPvProvider;
 }
@@ -103,13 +113,32 @@ DbPvProviderPtr getDbPvProvider()
 DbPvProvider::~DbPvProvider()
 {
 //printf("dbPvProvider::~dbPvProvider\n");
+    delete static_cast<RecordNameIndex *>(nameIndex);
+}
+
+void DbPvProvider::createNameIndex()
+{
+    // initHookAfterIocRunning also follows each iocRun
+    if(getNameIndex()) return;
+    RecordNameIndex *index = new RecordNameIndex();
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetPtrT(&nameIndex, index);
+}
+
+const RecordNameIndex * DbPvProvider::getNameIndex()
+{
+    EpicsAtomicPtrT index = epicsAtomicGetPtrT(&nameIndex);
+    epicsAtomicReadMemoryBarrier();
+    return static_cast<const RecordNameIndex *>(index);
 }
 
 ChannelFind::shared_pointer DbPvProvider::channelFind(
     string const & channelName,
     ChannelFindRequester::shared_pointer const &channelFindRequester)
 {
-    long result = dbChannelTest(channelName.c_str());
+    const RecordNameIndex *index = getNameIndex();
+    long result = index ? index->channelTest(channelName)
+                        : dbChannelTest(channelName.c_str());
     if(result==0) {
         channelFindRequester->channelFindResult(
             Status::Ok,
@@ -160,28 +189,71 @@ Channel::shared_pointer DbPvProvider::createChannel(
     short priority,
     string const & address)
 {
-    dbChannel *chan = dbChannelCreate(channelName.c_str());
+    DbPvSharePtr share(getShare(channelName, channelRequester));
+    if (!share) return Channel::shared_pointer();
+    DbPvPtr dbpv(new DbPv(
+            getPtrSelf(),
+            channelRequester, channelName, share));
+    {
+        // the security session pvAccess creates tells dbpv about changes
+        AccessRightsListenerScope scope(dbpv);
+        channelRequester->channelCreated(Status::Ok, dbpv);
+    }
+    return dbpv;
+}
+
+DbPvSharePtr DbPvProvider::getShare(
+    string const & channelName,
+    ChannelRequester::shared_pointer  const &channelRequester)
+{
+    {
+        Lock xx(sharesMutex);
+        std::map<string,std::tr1::weak_ptr<DbPvShare> >::iterator iter =
+            shares.find(channelName);
+        if(iter!=shares.end()) {
+            DbPvSharePtr share(iter->second.lock());
+            if(share) return share;
+        }
+    }
+    const RecordNameIndex *index = getNameIndex();
+    dbChannel *chan = 0;
+    if (!index || index->hasRecordOf(channelName)) {
+        chan = dbChannelCreate(channelName.c_str());
+    }
     if (!chan) {
         Status notFoundStatus(Status::STATUSTYPE_ERROR, "PV not found");
         channelRequester->channelCreated(
             notFoundStatus,
             Channel::shared_pointer());
-        return Channel::shared_pointer();
+        return DbPvSharePtr();
     }
     long status = dbChannelOpen(chan);
     if (status) {
+        dbChannelDelete(chan);
         Status cantOpenStatus(Status::STATUSTYPE_ERROR, "cannot open PV");
         channelRequester->channelCreated(
             cantOpenStatus,
             Channel::shared_pointer());
-        return Channel::shared_pointer();
+        return DbPvSharePtr();
     }
-    DbPvPtr dbpv(new DbPv(
-            getPtrSelf(),
-            channelRequester, channelName, chan));
-    dbpv->init();
-    channelRequester->channelCreated(Status::Ok, dbpv);
-    return dbpv;
+    DbPvSharePtr share(new DbPvShare(getPtrSelf(), channelName, chan));
+    if (ellCount(&chan->filters)!=0) return share;
+    Lock xx(sharesMutex);
+    std::tr1::weak_ptr<DbPvShare> &entry = shares[channelName];
+    // another client may have created the share meanwhile
+    DbPvSharePtr other(entry.lock());
+    if (other) return other;
+    entry = share;
+    return share;
+}
+
+void DbPvProvider::removeShare(string const & channelName)
+{
+    Lock xx(sharesMutex);
+    std::map<string,std::tr1::weak_ptr<DbPvShare> >::iterator iter =
+        shares.find(channelName);
+    // the name may already belong to a new share
+    if (iter!=shares.end() && iter->second.expired()) shares.erase(iter);
 }
 
 }}
@@ -29,6 +29,7 @@
 
 #include "dbPv.h"
 #include "dbUtil.h"
+#include "dbPvStats.h"
 
 using namespace epics::pvData;
 using namespace epics::pvAccess;
@@ -36,6 +37,8 @@ using std::string;
 
 namespace epics { namespace pvaSrv { 
 
+static const Status noWriteStatus(Status::STATUSTYPE_ERROR, "no write access");
+
 DbPvPut::DbPvPut(
         DbPvPtr const &dbPv,
         ChannelPutRequester::shared_pointer const &channelPutRequester)
@@ -45,15 +48,17 @@ DbPvPut::DbPvPut(
       propertyMask(0),
       process(false),
       block(false),
+      coalesce(false),
+      writeAllowed(1),
       firstTime(true),
       beingDestroyed(false)
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvPut::dbPvPut()\n");
+    DBPV_TRACE(putTrace, 1, "dbPvPut::dbPvPut()");
 }
 
 DbPvPut::~DbPvPut()
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvPut::~dbPvPut()\n");
+    DBPV_TRACE(putTrace, 1, "dbPvPut::~dbPvPut()");
 }
 
 bool DbPvPut::init(PVStructure::shared_pointer const &pvRequest)
@@ -78,6 +83,12 @@ bool DbPvPut::init(PVStructure::shared_pointer const &pvRequest)
             dbPv->getDbChannel(),
             pvRequest));
     if (!pvStructure.get()) return false;
+    putPlan = dbUtil->createAccessPlan(
+        req,
+        propertyMask,
+        dbPv->getDbChannel(),
+        pvStructure);
+    getPlan = putPlan;
     if (propertyMask & dbUtil->dbPutBit) {
         if (propertyMask & dbUtil->processBit) {
             if(req) req->message(
@@ -86,14 +97,21 @@ bool DbPvPut::init(PVStructure::shared_pointer const &pvRequest)
         }
     } else if (propertyMask&dbUtil->processBit) {
         process = true;
-        pNotify.reset(new (struct processNotify)());
-        struct processNotify *pn = pNotify.get();
-        pn->chan = dbPv->getDbChannel();
-        pn->requestType = putProcessRequest;
-        pn->putCallback  = this->putCallback;
-        pn->doneCallback = this->doneCallback;
-        pn->usrPvt = this;
-        if (propertyMask & dbUtil->blockBit) block = true;
+        if (propertyMask & dbUtil->blockBit) {
+            block = true;
+            notifyPool.init(
+                dbPv->getDbChannel(),
+                putProcessRequest,
+                this->putCallback,
+                0,
+                this->doneCallback,
+                this);
+        }
+    }
+    string coalesceString("record._options.coalesce");
+    {
+        PVStringPtr pvString = pvRequest.get()->getSubField<PVString>(coalesceString);
+        if (pvString && pvString->get() == "true") coalesce = true;
     }
     int numFields = pvStructure->getNumberFields();
     bitSet.reset(new BitSet(numFields));
@@ -116,29 +134,44 @@ void DbPvPut::message(string const &message,MessageType messageType)
 }
 
 void DbPvPut::destroy() {
-    if(DbPvDebug::getLevel()>0) printf("dbPvPut::destroy beingDestroyed %s\n",
-         (beingDestroyed ? "true" : "false"));
+    DBPV_TRACE_VALUE(putTrace, 1, "dbPvPut::destroy beingDestroyed", beingDestroyed);
     {
         Lock xx(mutex);
         if (beingDestroyed) return;
         beingDestroyed = true;
-        if (pNotify) dbNotifyCancel(pNotify.get());
     }
+    if (block) notifyPool.cancel();
 }
 
 void DbPvPut::put(PVStructurePtr const &pvStructure, BitSetPtr const & bitSet)
 {
-    if (DbPvDebug::getLevel() > 0) printf("dbPvPut::put()\n");
+    DBPV_TRACE(putTrace, 2, "dbPvPut::put()");
 
     this->pvStructure = pvStructure;
     this->bitSet = bitSet;
 
+    DbPvStats::increment(DbPvStats::putCounter);
+    if (coalesce) {
+        // the client may reuse pvStructure before the slot is applied
+        PVStructurePtr value(getPVDataCreate()->createPVStructure(pvStructure));
+        dbPv->getPutCoalescer()->put(getPtrSelf(), value, process);
+        return;
+    }
     if (block && process) {
-        dbProcessNotify(pNotify.get());
+        notifyPool.request(pvStructure, bitSet);
         return;
     }
 
+    Status status = putNow(pvStructure);
+    requester_type::shared_pointer req(channelPutRequester.lock());
+    if(req) req->putDone(status, getPtrSelf());
+}
+
+Status DbPvPut::putNow(PVStructurePtr const &pvStructure)
+{
+    if (!epicsAtomicGetIntT(&writeAllowed)) return noWriteStatus;
     requester_type::shared_pointer req(channelPutRequester.lock());
+    Status status;
 
     Lock lock(dataMutex);
     PVFieldPtr pvField = pvStructure.get()->getPVFields()[0];
@@ -150,75 +183,132 @@ void DbPvPut::put(PVStructurePtr const &pvStructure, BitSetPtr const & bitSet)
                     pvField);
     } else {
         dbScanLock(dbChannelRecord(dbPv->getDbChannel()));
-        status = dbUtil->put(
-                    req, propertyMask, dbPv->getDbChannel(), pvField);
+        DbPvTimer timer;
+        DbPvTimer convertTimer;
+        status = dbUtil->put(req, *putPlan, pvField);
+        convertTimer.stop(DbPvStats::putConvertHistogram);
         if (process) dbProcess(dbChannelRecord(dbPv->getDbChannel()));
         dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+        timer.stop(DbPvStats::putLockHistogram);
     }
-    lock.unlock();
-    if(req) req->putDone(status, getPtrSelf());
+    return status;
+}
+
+Status DbPvPut::putLocked(PVStructurePtr const &pvStructure, notifyPutType type)
+{
+    if (!epicsAtomicGetIntT(&writeAllowed)) return noWriteStatus;
+    requester_type::shared_pointer req(channelPutRequester.lock());
+    Status status;
+
+    Lock lock(dataMutex);
+    PVFieldPtr pvField = pvStructure.get()->getPVFields()[0];
+    DbPvTimer timer;
+    if (type == putFieldType) {
+        status = dbUtil->putField(
+                    req,
+                    propertyMask,
+                    dbPv->getDbChannel(),
+                    pvField);
+    } else {
+        status = dbUtil->put(req, *putPlan, pvField);
+    }
+    timer.stop(DbPvStats::putConvertHistogram);
+    return status;
 }
 
 int DbPvPut::putCallback(struct processNotify *pn, notifyPutType type)
 {
-    DbPvPut *pdp = static_cast<DbPvPut *>(pn->usrPvt);
+    NotifyPool::Request *request = NotifyPool::getRequest(pn);
+    DbPvPut *pdp = static_cast<DbPvPut *>(request->owner);
 
     if (pn->status == notifyCanceled) {
-        if (DbPvDebug::getLevel() > 0) printf("dbPvPut::putCallback notifyCanceled\n");
+        DBPV_TRACE(putTrace, 2, "dbPvPut::putCallback notifyCanceled");
         return 0;
     }
-    Lock lock(pdp->dataMutex);
-    PVFieldPtr pvField = pdp->pvStructure.get()->getPVFields()[0];
-    switch (type) {
-    case putDisabledType:
+    if (type == putDisabledType) {
+        pn->status = notifyError;
+        return 0;
+    }
+    if (!epicsAtomicGetIntT(&pdp->writeAllowed)) {
+        // revoked while the put was waiting, the record is not processed
+        request->status = noWriteStatus;
         pn->status = notifyError;
         return 0;
-    case putFieldType:
-        pdp->status = pdp->dbUtil->putField(
-                    pdp->channelPutRequester.lock(),
-                    pdp->propertyMask,
-                    pdp->dbPv->getDbChannel(),
-                    pvField);
-        break;
-    case putType:
-        pdp->status = pdp->dbUtil->put(
-                    pdp->channelPutRequester.lock(),
-                    pdp->propertyMask,
-                    pdp->dbPv->getDbChannel(),
-                    pvField);
-        break;
     }
-    if (!pdp->status.isSuccess())
+    request->status = pdp->putLocked(request->pvStructure, type);
+    if (!request->status.isSuccess())
         pn->status = notifyError;
     return 1;
 }
 
 void DbPvPut::doneCallback(struct processNotify *pn)
 {
-    DbPvPut *pdp = static_cast<DbPvPut *>(pn->usrPvt);
+    NotifyPool::Request *request = NotifyPool::getRequest(pn);
+    DbPvPut *pdp = static_cast<DbPvPut *>(request->owner);
+    DbPvPut::shared_pointer self(pdp->getPtrSelf());
 
+    request->timer.stop(DbPvStats::notifyHistogram);
     requester_type::shared_pointer req(pdp->channelPutRequester.lock());
     if(req) req->putDone(
-                pdp->status,
-                pdp->getPtrSelf());
+                request->status,
+                self);
+    pdp->notifyPool.release(request, self);
+}
+
+Status DbPvPut::coalescedPut(PVStructurePtr const &pvStructure)
+{
+    return putNow(pvStructure);
+}
+
+Status DbPvPut::coalescedPutNotify(
+    PVStructurePtr const &pvStructure,
+    notifyPutType type)
+{
+    return putLocked(pvStructure, type);
+}
+
+void DbPvPut::coalescedPutDone(Status const &status)
+{
+    requester_type::shared_pointer req(channelPutRequester.lock());
+    if(req) req->putDone(status, getPtrSelf());
+}
+
+void DbPvPut::accessRightsChanged(bool canWrite)
+{
+    DBPV_TRACE_VALUE(putTrace, 1, "dbPvPut::accessRightsChanged canWrite", canWrite);
+    int allowed = canWrite ? 1 : 0;
+    if (epicsAtomicGetIntT(&writeAllowed) == allowed) return;
+    epicsAtomicSetIntT(&writeAllowed, allowed);
+    if (canWrite) message("write access restored", infoMessage);
+    else message("write access revoked", warningMessage);
 }
 
 void DbPvPut::get()
 {
-    if(DbPvDebug::getLevel()>0) printf("dbPvPut::get()\n");
+    DBPV_TRACE(putTrace, 2, "dbPvPut::get()");
     requester_type::shared_pointer req(channelPutRequester.lock());
     {
         Lock lock(dataMutex);
+        // put replaces pvStructure with the one of the client
+        if (getPlan->pvStructure != pvStructure) {
+            getPlan = dbUtil->createAccessPlan(
+                req,
+                propertyMask,
+                dbPv->getDbChannel(),
+                pvStructure);
+        }
         dbScanLock(dbChannelRecord(dbPv->getDbChannel()));
+        DbPvTimer timer;
+        dbUtil->readRecord(*getPlan, recordData, 0);
+        dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+        timer.lap(DbPvStats::getLockHistogram);
         bitSet->clear();
         Status status = dbUtil->get(
                     req,
-                    propertyMask,
-                    dbPv->getDbChannel(),
-                    pvStructure,
+                    *getPlan,
                     bitSet,
-                    0);
-        dbScanUnlock(dbChannelRecord(dbPv->getDbChannel()));
+                    recordData);
+        timer.stop(DbPvStats::getConvertHistogram);
         if(firstTime) {
             firstTime = false;
             bitSet->set(pvStructure->getFieldOffset());
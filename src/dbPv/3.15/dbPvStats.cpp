@@ -0,0 +1,287 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Counters and latency histograms of the dbPv provider,
+ * and the iocsh command dbpvStats that prints them.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <epicsAtomic.h>
+#include <epicsTime.h>
+#include <epicsVersion.h>
+#include <iocsh.h>
+
+#define epicsExportSharedSymbols
+
+#include <epicsExport.h>
+#include "dbPvStats.h"
+
+using std::string;
+
+// Set non-zero to count and time get, put and monitor operations
+extern "C" {
+    int dbPvStatsEnable = 0;
+    epicsExportAddress(int, dbPvStatsEnable);
+}
+
+// epicsMonotonicGet exists since 3.16.1
+#if EPICS_VERSION>3 || (EPICS_VERSION==3 && (EPICS_REVISION>16 \
+    || (EPICS_REVISION==16 && EPICS_MODIFICATION>=1)))
+#define DBPV_MONOTONIC_CLOCK 1
+#endif
+
+namespace epics { namespace pvaSrv {
+
+struct HistogramData {
+    size_t count;
+    size_t sum;
+    size_t max;
+    size_t buckets[DbPvStats::numberBuckets];
+};
+
+static size_t counters[DbPvStats::numberCounters];
+static HistogramData histograms[DbPvStats::numberHistograms];
+
+static const char *counterNames[DbPvStats::numberCounters] = {
+    "get",
+    "put",
+    "monitorEvent",
+    "monitorSquash",
+    "monitorDropOldest",
+    "monitorDropNewest",
+    "notifyPending",
+    "putSuperseded"
+};
+
+static const char *histogramNames[DbPvStats::numberHistograms] = {
+    "getLock",
+    "putLock",
+    "monitorLock",
+    "getConvert",
+    "putConvert",
+    "monitorConvert",
+    "notify",
+    "monitorQueue"
+};
+
+static const char *statisticNames[DbPvStats::numberStatistics] = {
+    "count",
+    "mean",
+    "max",
+    "p50",
+    "p99"
+};
+
+static size_t bucketOf(size_t value)
+{
+    size_t bucket = 0;
+    while(value!=0 && bucket<DbPvStats::numberBuckets-1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// the largest value counted by bucket
+static double bucketLimit(size_t bucket)
+{
+    if(bucket==0) return 0.0;
+    return static_cast<double>((static_cast<epicsUInt64>(1)<<bucket)-1);
+}
+
+void DbPvStats::increment(Counter counter)
+{
+    if(!isEnabled()) return;
+    epicsAtomicIncrSizeT(&counters[counter]);
+}
+
+void DbPvStats::add(Histogram histogram, size_t value)
+{
+    if(!isEnabled()) return;
+    HistogramData &data = histograms[histogram];
+    epicsAtomicIncrSizeT(&data.count);
+    epicsAtomicAddSizeT(&data.sum, value);
+    epicsAtomicIncrSizeT(&data.buckets[bucketOf(value)]);
+    size_t max = epicsAtomicGetSizeT(&data.max);
+    while(value>max) {
+        size_t old = epicsAtomicCmpAndSwapSizeT(&data.max, max, value);
+        if(old==max) break;
+        max = old;
+    }
+}
+
+size_t DbPvStats::getCount(Counter counter)
+{
+    return epicsAtomicGetSizeT(&counters[counter]);
+}
+
+double DbPvStats::getStatistic(Histogram histogram, Statistic statistic)
+{
+    HistogramData &data = histograms[histogram];
+    size_t count = epicsAtomicGetSizeT(&data.count);
+    switch(statistic) {
+    case countStatistic:
+        return static_cast<double>(count);
+    case meanStatistic:
+        if(count==0) return 0.0;
+        return static_cast<double>(epicsAtomicGetSizeT(&data.sum))/count;
+    case maxStatistic:
+        return static_cast<double>(epicsAtomicGetSizeT(&data.max));
+    case p50Statistic:
+    case p99Statistic: {
+        size_t buckets[numberBuckets];
+        size_t total = 0;
+        for(size_t i=0; i<numberBuckets; i++) {
+            buckets[i] = epicsAtomicGetSizeT(&data.buckets[i]);
+            total += buckets[i];
+        }
+        if(total==0) return 0.0;
+        double fraction = statistic==p50Statistic ? 0.5 : 0.99;
+        size_t sum = 0;
+        for(size_t i=0; i<numberBuckets; i++) {
+            sum += buckets[i];
+            if(sum>=fraction*total) return bucketLimit(i);
+        }
+        return bucketLimit(numberBuckets-1);
+    }
+    default:
+        return 0.0;
+    }
+}
+
+const char * DbPvStats::getName(Counter counter)
+{
+    return counterNames[counter];
+}
+
+const char * DbPvStats::getName(Histogram histogram)
+{
+    return histogramNames[histogram];
+}
+
+const char * DbPvStats::getName(Statistic statistic)
+{
+    return statisticNames[statistic];
+}
+
+bool DbPvStats::findCounter(string const &name, Counter &counter)
+{
+    for(int i=0; i<numberCounters; i++) {
+        if(name!=counterNames[i]) continue;
+        counter = static_cast<Counter>(i);
+        return true;
+    }
+    return false;
+}
+
+bool DbPvStats::findHistogram(string const &name, Histogram &histogram)
+{
+    for(int i=0; i<numberHistograms; i++) {
+        if(name!=histogramNames[i]) continue;
+        histogram = static_cast<Histogram>(i);
+        return true;
+    }
+    return false;
+}
+
+bool DbPvStats::findStatistic(string const &name, Statistic &statistic)
+{
+    for(int i=0; i<numberStatistics; i++) {
+        if(name!=statisticNames[i]) continue;
+        statistic = static_cast<Statistic>(i);
+        return true;
+    }
+    return false;
+}
+
+void DbPvStats::report(int level)
+{
+    printf("dbPvStatsEnable %d\n", dbPvStatsEnable);
+    for(int i=0; i<numberCounters; i++) {
+        printf("%-18s %lu\n", counterNames[i],
+            (unsigned long)getCount(static_cast<Counter>(i)));
+    }
+    printf("%-18s %10s %10s %10s %10s %10s\n",
+        "", "count", "mean", "max", "p50<=", "p99<=");
+    for(int i=0; i<numberHistograms; i++) {
+        Histogram histogram = static_cast<Histogram>(i);
+        printf("%-18s %10.0f %10.1f %10.0f %10.0f %10.0f\n",
+            histogramNames[i],
+            getStatistic(histogram, countStatistic),
+            getStatistic(histogram, meanStatistic),
+            getStatistic(histogram, maxStatistic),
+            getStatistic(histogram, p50Statistic),
+            getStatistic(histogram, p99Statistic));
+        if(level<1) continue;
+        HistogramData &data = histograms[i];
+        for(size_t j=0; j<numberBuckets; j++) {
+            size_t count = epicsAtomicGetSizeT(&data.buckets[j]);
+            if(count==0) continue;
+            printf("    <=%-10.0f %lu\n", bucketLimit(j), (unsigned long)count);
+        }
+    }
+    printf("times in microseconds, monitorQueue in elements\n");
+}
+
+void DbPvStats::reset()
+{
+    for(int i=0; i<numberCounters; i++) {
+        epicsAtomicSetSizeT(&counters[i], 0);
+    }
+    for(int i=0; i<numberHistograms; i++) {
+        HistogramData &data = histograms[i];
+        epicsAtomicSetSizeT(&data.count, 0);
+        epicsAtomicSetSizeT(&data.sum, 0);
+        epicsAtomicSetSizeT(&data.max, 0);
+        for(size_t j=0; j<numberBuckets; j++) {
+            epicsAtomicSetSizeT(&data.buckets[j], 0);
+        }
+    }
+}
+
+epicsUInt64 DbPvStats::now()
+{
+#ifdef DBPV_MONOTONIC_CLOCK
+    return epicsMonotonicGet();
+#else
+    epicsTimeStamp stamp;
+    epicsTimeGetCurrent(&stamp);
+    return static_cast<epicsUInt64>(stamp.secPastEpoch)*1000000000u
+        + stamp.nsec;
+#endif
+}
+
+}}
+
+using namespace epics::pvaSrv;
+
+static const iocshArg statsArg0 = { "level", iocshArgInt };
+static const iocshArg statsArg1 = { "reset", iocshArgInt };
+static const iocshArg *statsArgs[] = {&statsArg0, &statsArg1};
+
+static const iocshFuncDef dbpvStatsFuncDef = {
+    "dbpvStats", 2, statsArgs};
+
+static void dbpvStatsCallFunc(const iocshArgBuf *args)
+{
+    DbPvStats::report(args[0].ival);
+    if(args[1].ival) DbPvStats::reset();
+}
+
+static void dbPvStatsRegister(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        firstTime = 0;
+        iocshRegister(&dbpvStatsFuncDef, dbpvStatsCallFunc);
+    }
+}
+
+extern "C" {
+    epicsExportRegistrar(dbPvStatsRegister);
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Counters and latency histograms of the dbPv provider.
+ *
+ * Nothing is measured unless the iocsh variable dbPvStatsEnable is
+ * non-zero, so that a disabled build pays one load per call site.
+ * Histograms have log2 buckets: bucket 0 counts the value 0,
+ * bucket i the values from 2^(i-1) to 2^i-1, the last one all larger.
+ * Times are in microseconds. All updates are atomic, without locks.
+ *
+ * The iocsh command dbpvStats prints them; records with DTYP
+ * "dbPvStats" serve them as PVs.
+ */
+
+#ifndef DBPVSTATS_H
+#define DBPVSTATS_H
+
+#include <cstddef>
+#include <string>
+
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+extern "C" {
+    epicsShareExtern int dbPvStatsEnable;
+}
+
+namespace epics { namespace pvaSrv {
+
+class epicsShareClass DbPvStats {
+public:
+    enum Counter {
+        getCounter,
+        putCounter,
+        monitorEventCounter,
+        monitorSquashCounter,      // update merged into the newest element
+        monitorDropOldestCounter,  // oldest queued element discarded
+        monitorDropNewestCounter,  // update held back, queue full
+        notifyPendingCounter,      // blocking request queued, pool busy
+        putSupersededCounter,      // coalescing put replaced by a newer one
+        numberCounters
+    };
+    // the Lock histograms start when dbScanLock returns, without the wait
+    enum Histogram {
+        getLockHistogram,         // dbScanLock held by a get
+        putLockHistogram,         // dbScanLock held by a put
+        monitorLockHistogram,     // dbScanLock held by a monitor event
+        getConvertHistogram,      // record data to pvData
+        putConvertHistogram,      // pvData to the record
+        monitorConvertHistogram,  // record data to pvData
+        notifyHistogram,          // dbProcessNotify until done
+        monitorQueueHistogram,    // elements queued after an event
+        numberHistograms
+    };
+    enum { numberBuckets = 24 };
+    enum Statistic {
+        countStatistic,
+        meanStatistic,
+        maxStatistic,
+        p50Statistic,   // upper bound of the bucket
+        p99Statistic,
+        numberStatistics
+    };
+
+    static bool isEnabled() { return dbPvStatsEnable!=0; }
+    static void increment(Counter counter);
+    static void add(Histogram histogram, size_t value);
+    static size_t getCount(Counter counter);
+    static double getStatistic(Histogram histogram, Statistic statistic);
+    static const char * getName(Counter counter);
+    static const char * getName(Histogram histogram);
+    static const char * getName(Statistic statistic);
+    /* Return false if there is no counter or histogram of that name */
+    static bool findCounter(std::string const &name, Counter &counter);
+    static bool findHistogram(std::string const &name, Histogram &histogram);
+    static bool findStatistic(std::string const &name, Statistic &statistic);
+    /* level 0: counters and histogram summaries, 1: also the buckets */
+    static void report(int level);
+    static void reset();
+    /* nanoseconds of a monotonic clock where base has one */
+    static epicsUInt64 now();
+};
+
+/* Measures the time since start or the last lap.
+ * Does nothing if statistics were disabled when it was started.
+ */
+class DbPvTimer {
+public:
+    DbPvTimer() : running(false), startTime(0) { start(); }
+    void start()
+    {
+        running = DbPvStats::isEnabled();
+        if(running) startTime = DbPvStats::now();
+    }
+    void lap(DbPvStats::Histogram histogram)
+    {
+        if(!running) return;
+        epicsUInt64 time = DbPvStats::now();
+        DbPvStats::add(histogram, static_cast<size_t>((time-startTime)/1000));
+        startTime = time;
+    }
+    void stop(DbPvStats::Histogram histogram)
+    {
+        lap(histogram);
+        running = false;
+    }
+private:
+    bool running;
+    epicsUInt64 startTime;
+};
+
+}}
+
+#endif  /* DBPVSTATS_H */
@@ -0,0 +1,212 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The trace ring buffer of the dbPv provider,
+ * and the iocsh commands dbpvTrace and dbpvTraceDump.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <epicsAtomic.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+
+#define epicsExportSharedSymbols
+
+#include <epicsExport.h>
+#include "dbPvTrace.h"
+
+using std::string;
+
+namespace epics { namespace pvaSrv {
+
+// must be a power of two
+static const size_t traceEntries = 4096;
+
+struct TraceEntry {
+    size_t sequence;    // entry number plus one, 0 while being written
+    epicsTimeStamp time;
+    epicsThreadId thread;
+    const char *message;
+    long value;
+    bool hasValue;
+    int subsystem;
+    int level;
+};
+
+static TraceEntry traceRing[traceEntries];
+static size_t traceNext;    // number of entries ever added
+
+static const char *subsystemNames[DbPvTrace::numberSubsystems] = {
+    "channel",
+    "get",
+    "put",
+    "process",
+    "array",
+    "monitor",
+    "ca"
+};
+
+int DbPvTrace::levels[DbPvTrace::numberSubsystems];
+
+static void addEntry(
+    int subsystem, int level, const char *message, long value, bool hasValue)
+{
+    size_t number = epicsAtomicIncrSizeT(&traceNext) - 1;
+    TraceEntry &entry = traceRing[number&(traceEntries-1)];
+    epicsAtomicSetSizeT(&entry.sequence, 0);
+    epicsAtomicWriteMemoryBarrier();
+    epicsTimeGetCurrent(&entry.time);
+    entry.thread = epicsThreadGetIdSelf();
+    entry.message = message;
+    entry.value = value;
+    entry.hasValue = hasValue;
+    entry.subsystem = subsystem;
+    entry.level = level;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&entry.sequence, number+1);
+}
+
+void DbPvTrace::add(Subsystem subsystem, int level, const char *message)
+{
+    addEntry(subsystem, level, message, 0, false);
+}
+
+void DbPvTrace::add(
+    Subsystem subsystem, int level, const char *message, long value)
+{
+    addEntry(subsystem, level, message, value, true);
+}
+
+void DbPvTrace::setLevel(Subsystem subsystem, int level)
+{
+    levels[subsystem] = level;
+}
+
+const char * DbPvTrace::getName(Subsystem subsystem)
+{
+    return subsystemNames[subsystem];
+}
+
+bool DbPvTrace::find(string const &name, Subsystem &subsystem)
+{
+    for(int i=0; i<numberSubsystems; i++) {
+        if(name!=subsystemNames[i]) continue;
+        subsystem = static_cast<Subsystem>(i);
+        return true;
+    }
+    return false;
+}
+
+void DbPvTrace::dump(size_t count)
+{
+    size_t next = epicsAtomicGetSizeT(&traceNext);
+    if(count>traceEntries) count = traceEntries;
+    if(count>next) count = next;
+    epicsTimeStamp newest = epicsTimeStamp();
+    if(next>0) newest = traceRing[(next-1)&(traceEntries-1)].time;
+    for(size_t number=next-count; number<next; number++) {
+        TraceEntry const &slot = traceRing[number&(traceEntries-1)];
+        // an entry overwritten while it is copied is skipped
+        size_t sequence = epicsAtomicGetSizeT(&slot.sequence);
+        epicsAtomicReadMemoryBarrier();
+        TraceEntry entry = slot;
+        epicsAtomicReadMemoryBarrier();
+        if(sequence!=number+1
+        || epicsAtomicGetSizeT(&slot.sequence)!=sequence) continue;
+        double age = epicsTimeDiffInSeconds(&entry.time, &newest)*1e6;
+        if(age>0.0) age = 0.0;
+        printf("%12.1f %p %-8s %d %s",
+            age,
+            static_cast<void *>(entry.thread),
+            subsystemNames[entry.subsystem],
+            entry.level,
+            entry.message);
+        if(entry.hasValue) printf(" %ld", entry.value);
+        printf("\n");
+    }
+    printf("%lu entries, times in microseconds before the newest\n",
+        (unsigned long)count);
+}
+
+void DbPvTrace::clear()
+{
+    for(size_t i=0; i<traceEntries; i++) {
+        epicsAtomicSetSizeT(&traceRing[i].sequence, 0);
+    }
+    epicsAtomicSetSizeT(&traceNext, 0);
+}
+
+}}
+
+using namespace epics::pvaSrv;
+
+static const iocshArg traceArg0 = { "subsystem", iocshArgString };
+static const iocshArg traceArg1 = { "level", iocshArgInt };
+static const iocshArg *traceArgs[] = {&traceArg0, &traceArg1};
+
+static const iocshFuncDef dbpvTraceFuncDef = {
+    "dbpvTrace", 2, traceArgs};
+
+static void dbpvTraceCallFunc(const iocshArgBuf *args)
+{
+    const char *name = args[0].sval;
+    if(!name) {
+        for(int i=0; i<DbPvTrace::numberSubsystems; i++) {
+            DbPvTrace::Subsystem subsystem =
+                static_cast<DbPvTrace::Subsystem>(i);
+            printf("%-8s %d\n",
+                DbPvTrace::getName(subsystem),
+                DbPvTrace::getLevel(subsystem));
+        }
+        printf("levels above %d are compiled out\n", DBPV_TRACE_MAX_LEVEL);
+        return;
+    }
+    if(strcmp(name, "all")==0) {
+        for(int i=0; i<DbPvTrace::numberSubsystems; i++) {
+            DbPvTrace::setLevel(
+                static_cast<DbPvTrace::Subsystem>(i), args[1].ival);
+        }
+        return;
+    }
+    DbPvTrace::Subsystem subsystem;
+    if(!DbPvTrace::find(name, subsystem)) {
+        printf("dbpvTrace unknown subsystem %s\n", name);
+        return;
+    }
+    DbPvTrace::setLevel(subsystem, args[1].ival);
+}
+
+static const iocshArg dumpArg0 = { "count", iocshArgInt };
+static const iocshArg dumpArg1 = { "clear", iocshArgInt };
+static const iocshArg *dumpArgs[] = {&dumpArg0, &dumpArg1};
+
+static const iocshFuncDef dbpvTraceDumpFuncDef = {
+    "dbpvTraceDump", 2, dumpArgs};
+
+static void dbpvTraceDumpCallFunc(const iocshArgBuf *args)
+{
+    int count = args[0].ival;
+    if(count<=0) count = 100;
+    DbPvTrace::dump(count);
+    if(args[1].ival) DbPvTrace::clear();
+}
+
+static void dbPvTraceRegister(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        firstTime = 0;
+        iocshRegister(&dbpvTraceFuncDef, dbpvTraceCallFunc);
+        iocshRegister(&dbpvTraceDumpFuncDef, dbpvTraceDumpCallFunc);
+    }
+}
+
+extern "C" {
+    epicsExportRegistrar(dbPvTraceRegister);
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Tracing of the dbPv provider into an in-memory ring buffer.
+ *
+ * DBPV_TRACE(subsystem, level, message) records message, which must be
+ * a string literal, if the level of subsystem is at least level.
+ * The check is an inline load of the level; nothing is formatted.
+ * Calls with a level above DBPV_TRACE_MAX_LEVEL compile to nothing.
+ * The default is 1, so the per-operation traces are not in a normal
+ * build; set it to 2 in CONFIG_SITE for them, or to 0 to remove all.
+ *
+ * Level 1 traces creation and destruction, level 2 every operation.
+ * The ring keeps the newest entries; writers reserve a slot with an
+ * atomic increment and never block. The iocsh command dbpvTraceDump
+ * prints it, dbpvTrace sets the levels.
+ */
+
+#ifndef DBPVTRACE_H
+#define DBPVTRACE_H
+
+#include <cstddef>
+#include <string>
+
+#include <shareLib.h>
+
+#ifndef DBPV_TRACE_MAX_LEVEL
+#define DBPV_TRACE_MAX_LEVEL 1
+#endif
+
+#define DBPV_TRACE_IF(subsystem, level) \
+    if((level)<=DBPV_TRACE_MAX_LEVEL \
+    && ::epics::pvaSrv::DbPvTrace::isEnabled( \
+           ::epics::pvaSrv::DbPvTrace::subsystem, (level)))
+
+#define DBPV_TRACE(subsystem, level, message) \
+    do { \
+        DBPV_TRACE_IF(subsystem, level) ::epics::pvaSrv::DbPvTrace::add( \
+            ::epics::pvaSrv::DbPvTrace::subsystem, (level), (message)); \
+    } while(0)
+
+/* also records value, for example a reference count */
+#define DBPV_TRACE_VALUE(subsystem, level, message, value) \
+    do { \
+        DBPV_TRACE_IF(subsystem, level) ::epics::pvaSrv::DbPvTrace::add( \
+            ::epics::pvaSrv::DbPvTrace::subsystem, (level), (message), \
+            static_cast<long>(value)); \
+    } while(0)
+
+namespace epics { namespace pvaSrv {
+
+class epicsShareClass DbPvTrace {
+public:
+    enum Subsystem {
+        channelTrace,   // provider, channels
+        getTrace,
+        putTrace,
+        processTrace,
+        arrayTrace,
+        monitorTrace,   // monitors, shares and database events
+        caTrace,        // CA client context and monitors
+        numberSubsystems
+    };
+    static bool isEnabled(Subsystem subsystem, int level)
+    {
+        return level<=levels[subsystem];
+    }
+    static void add(Subsystem subsystem, int level, const char *message);
+    static void add(
+        Subsystem subsystem, int level, const char *message, long value);
+    static void setLevel(Subsystem subsystem, int level);
+    static int getLevel(Subsystem subsystem) { return levels[subsystem]; }
+    static const char * getName(Subsystem subsystem);
+    /* Returns false if there is no subsystem of that name */
+    static bool find(std::string const &name, Subsystem &subsystem);
+    /* prints the newest count entries, oldest first */
+    static void dump(size_t count);
+    static void clear();
+private:
+    static int levels[numberSubsystems];
+};
+
+}}
+
+#endif  /* DBPVTRACE_H */
@@ -0,0 +1,56 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef DBRECORDDATA_H
+#define DBRECORDDATA_H
+
+#include <string>
+#include <vector>
+
+#include <dbAccess.h>
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+
+namespace epics { namespace pvaSrv {
+
+/* What DbUtil::get converts into a PVStructure, copied from the record
+ * (or from the CaData of an event) by DbUtil::readRecord.
+ * Reading only copies bytes, so that the record is locked for as
+ * short a time as possible; get converts after dbScanUnlock.
+ * An array value is a frozen snapshot, a string array the characters.
+ */
+struct DbRecordData {
+    DbRecordData();
+    union {
+        epics::pvData::int8   byteValue;
+        epics::pvData::uint8  ubyteValue;
+        epics::pvData::int16  shortValue;
+        epics::pvData::uint16 ushortValue;
+        epics::pvData::int32  intValue;   // also the index of an enum
+        epics::pvData::uint32 uintValue;
+        float                 floatValue;
+        double                doubleValue;
+    };
+    std::vector<char> stringValue;  // the whole field, or a link as a string
+    epicsTimeStamp timeStamp;
+    int status;       // alarm status and severity, as in pvData
+    int severity;
+    epicsEnum16 recordStat;         // for the message, if no CaData
+    const std::string *message;     // of the CaData
+    bool readFailed;                // dbGetField of a link failed
+    char units[DB_UNITS_SIZE];
+    long precision;
+    struct dbr_grDouble graphics;
+    struct dbr_ctrlDouble control;
+    struct dbr_alDouble alarmLimits;
+    epics::pvData::shared_vector<const void> array;
+    std::vector<char> stringArray;
+    size_t stringSize;              // of each element of stringArray
+};
+
+}}
+
+#endif  /* DBRECORDDATA_H */
@@ -9,6 +9,7 @@
 #include <string>
 #include <cstring>
 #include <stdexcept>
+#include <sstream>
 
 #include <dbAccess.h>
 #include <dbChannel.h>
@@ -17,6 +18,7 @@
 #include <special.h>
 #include <link.h>
 #include <alarm.h>
+#include <epicsStdio.h>
 
 #include <pv/pvIntrospect.h>
 #include <pv/pvData.h>
@@ -35,6 +37,9 @@
 #include <pv/caStatus.h>
 
 #include "dbUtil.h"
+#include "arraySnapshotPool.h"
+#include "arrayCopy.h"
+#include "enumChoicesCache.h"
 
 using namespace epics::pvData;
 using std::tr1::static_pointer_cast;
@@ -90,6 +95,49 @@ static StructureConstPtr refineStructure(StructureConstPtr const & source,
     return  builder->createStructure();
 }
 
+// Entries of each request cache, which is emptied when full
+static const size_t maxCacheEntries = 256;
+
+// Appends a text form of pvStructure that is the same for the same
+// field names and nesting and, if withValues, the same scalar values.
+static void appendSignature(
+    string &signature, PVStructure const &pvStructure, bool withValues)
+{
+    StringArray const &names = pvStructure.getStructure()->getFieldNames();
+    PVFieldPtrArray const &pvFields = pvStructure.getPVFields();
+    signature += '{';
+    for(size_t i=0; i<pvFields.size(); i++) {
+        if(i>0) signature += ',';
+        signature += names[i];
+        PVFieldPtr const &pvField = pvFields[i];
+        Type type = pvField->getField()->getType();
+        if(type==structure) {
+            appendSignature(signature,
+                static_cast<PVStructure const &>(*pvField), withValues);
+            continue;
+        }
+        if(!withValues) continue;
+        string value;
+        if(type==scalar) {
+            PVScalarPtr pvScalar = static_pointer_cast<PVScalar>(pvField);
+            value = ScalarTypeFunc::name(pvScalar->getScalar()->getScalarType());
+            value += ' ';
+            value += getConvert()->toString(pvScalar);
+        } else {
+            std::ostringstream stream;
+            stream << *pvField;
+            value = stream.str();
+        }
+        // the length keeps values from running into the next field
+        char length[24];
+        epicsSnprintf(length, sizeof(length), "=%lu:",
+            (unsigned long)value.size());
+        signature += length;
+        signature += value;
+    }
+    signature += '}';
+}
+
 // Return DBF type of final field (after any filters applied)
 static short dbChannelFinalDBFType(dbChannel *dbChan)
 {
@@ -104,6 +152,337 @@ static short dbChannelFinalDBFType(dbChannel *dbChan)
         return dbChannelFinalFieldType(dbChan);
 }
 
+// Copy the record array into a new snapshot with a single copy,
+// reusing a buffer from the pool when one is free.
+// A record with a circular buffer has its first element at offset.
+template<typename T>
+static void readArraySnapshot(
+    DbRecordData &data,
+    dbChannel *dbChan,
+    size_t length,
+    size_t offset,
+    ArraySnapshotPool *arrayPool)
+{
+    shared_vector<T> buffer(arrayPool ?
+        arrayPool->take<T>(length) : shared_vector<T>(length));
+    const T *from = static_cast<const T *>(dbChannelField(dbChan));
+    if(offset==0) {
+        copyElements(buffer.data(), from, length);
+    } else {
+        gatherRingElements(buffer.data(), from,
+            dbChannelElements(dbChan), offset, length, 1);
+    }
+    shared_vector<const T> snapshot(freeze(buffer));
+    if(arrayPool) arrayPool->keep(snapshot);
+    data.array = static_shared_vector_cast<const void>(snapshot);
+}
+
+// The value accessors of DbAccessPlan, selected by createAccessPlan.
+// The read functions copy the value into DbRecordData while the record
+// is locked, the get functions convert it afterwards.
+
+template<typename T, T DbRecordData::*dataValue, T CaData::*caValue>
+static void readScalarValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    if(caData) {
+        data.*dataValue = caData->*caValue;
+    } else {
+        data.*dataValue = *static_cast<T *>(dbChannelField(plan.dbChan));
+    }
+}
+
+template<typename T, T DbRecordData::*dataValue>
+static bool getScalarValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    DbRecordData const &data)
+{
+    T val = data.*dataValue;
+    PVScalarValue<T> *pv = static_cast<PVScalarValue<T> *>(plan.pvValue.get());
+    if(pv->get()==val) return false;
+    pv->put(val);
+    return true;
+}
+
+static bool putChangedString(PVString *pvString, const char *val)
+{
+    if(!pvString->get().empty() && pvString->get().compare(val)==0) {
+        return false;
+    }
+    pvString->put(string(val));
+    return true;
+}
+
+static void readStringValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    // a no-op once data has read this plan
+    data.stringValue.resize(plan.stringValueSize);
+    copyElements(&data.stringValue[0],
+        static_cast<const char *>(dbChannelField(plan.dbChan)),
+        plan.stringValueSize);
+    data.stringValue[plan.stringValueSize-1] = 0;
+}
+
+static void readLinkValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    data.stringValue.assign(MAX_STRING_SIZE, 0);
+    long result = dbGetField(&plan.dbChan->addr,DBR_STRING,
+                             &data.stringValue[0],0,0,0);
+    data.stringValue[MAX_STRING_SIZE-1] = 0;
+    data.readFailed = (result!=0);
+}
+
+static bool getStringValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    DbRecordData const &data)
+{
+    if(data.readFailed) {
+        if(requester) requester->message("dbGetField error",errorMessage);
+    }
+    return putChangedString(
+        static_cast<PVString *>(plan.pvValue.get()), &data.stringValue[0]);
+}
+
+static void getArrayBounds(
+    DbAccessPlan const &plan, size_t &length, size_t &offset)
+{
+    long rec_length = 0;
+    long rec_offset = 0;
+    plan.getArrayInfo(&plan.dbChan->addr, &rec_length, &rec_offset);
+    length = rec_length;
+    offset = rec_offset;
+}
+
+template<typename T>
+static void readArrayValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    size_t length, offset;
+    getArrayBounds(plan, length, offset);
+    readArraySnapshot<T>(data, plan.dbChan, length, offset, arrayPool);
+}
+
+template<typename T>
+static bool getArrayValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    DbRecordData const &data)
+{
+    static_cast<PVValueArray<T> *>(plan.pvValue.get())->replace(
+        static_shared_vector_cast<const T>(data.array));
+    return true;
+}
+
+// Only the characters are copied, the strings are created by get
+static void readStringArrayValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    size_t length, offset;
+    getArrayBounds(plan, length, offset);
+    char *pv3 = static_cast<char *>(dbChannelField(plan.dbChan));
+    size_t size = dbChannelFinalFieldSize(plan.dbChan);
+    size_t capacity = dbChannelElements(plan.dbChan);
+    if(length>capacity) length = capacity;
+    data.stringArray.resize(length*size);
+    data.stringSize = size;
+    if(length==0) return;
+    offset %= capacity;
+    // at most two segments, before and after the end of the buffer
+    size_t first = capacity - offset;
+    if(first>length) first = length;
+    copyElements(&data.stringArray[0], pv3 + offset*size, first*size);
+    copyElements(&data.stringArray[first*size], pv3, (length-first)*size);
+}
+
+static bool getStringArrayValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    DbRecordData const &data)
+{
+    size_t size = data.stringSize;
+    size_t length = size ? data.stringArray.size()/size : 0;
+    shared_vector<string> xxx(length);
+    for(size_t i=0; i<length; i++) {
+        const char *from = &data.stringArray[i*size];
+        const char *end = static_cast<const char *>(memchr(from, 0, size));
+        xxx[i] = string(from, end ? end - from : size);
+    }
+    shared_vector<const string> value(freeze(xxx));
+    static_cast<PVStringArray *>(plan.pvValue.get())->replace(value);
+    return true;
+}
+
+static void readEnumValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    if(caData) {
+        data.intValue = caData->intValue;
+    } else {
+        data.intValue = static_cast<int32>(*static_cast<epicsEnum16 *>(dbChannelField(plan.dbChan)));
+    }
+}
+
+static void readDeviceValue(
+    DbAccessPlan const &plan,
+    DbRecordData &data,
+    CaData *caData,
+    ArraySnapshotPool *arrayPool)
+{
+    if(caData) {
+        data.intValue = caData->intValue;
+    } else {
+        data.intValue = static_cast<epicsEnum16>(dbChannelRecord(plan.dbChan)->dtyp);
+    }
+}
+
+static bool getEnumValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    DbRecordData const &data)
+{
+    PVInt *pvIndex = static_cast<PVInt *>(plan.pvValue.get());
+    if(pvIndex->get()==data.intValue) return false;
+    pvIndex->put(data.intValue);
+    return true;
+}
+
+template<typename T>
+static bool putScalarValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    T * val = static_cast<T *>(dbChannelField(plan.dbChan));
+    *val = static_cast<PVScalarValue<T> *>(pvField)->get();
+    return true;
+}
+
+static bool putStringValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    char * to = static_cast<char *>(dbChannelField(plan.dbChan));
+    PVString *pvString = static_cast<PVString *>(pvField);
+    if(pvString->get().empty()) {
+        *(to) = 0;
+    } else {
+        int size = dbChannelFinalFieldSize(plan.dbChan)-1;
+        int fromLen = pvString->get().length();
+        if(fromLen<size) size = fromLen;
+        strncpy(to,pvString->get().c_str(),size);
+        *(to + size) = 0;
+    }
+    return true;
+}
+
+static long putArrayLength(DbAccessPlan const &plan, long length)
+{
+    long no_elements  = dbChannelFinalElements(plan.dbChan);
+    if(length>no_elements) length = no_elements;
+    if(plan.putArrayInfo) plan.putArrayInfo(&plan.dbChan->addr, length);
+    return length;
+}
+
+template<typename T>
+static bool putArrayValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    typename PVValueArray<T>::const_svector xxx(
+        static_cast<PVValueArray<T> *>(pvField)->view());
+    long length = putArrayLength(plan, xxx.size());
+    copyElements(static_cast<T *>(dbChannelField(plan.dbChan)),
+        xxx.data(), length);
+    return true;
+}
+
+static bool putStringArrayValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    PVStringArray::const_svector xxx(
+        static_cast<PVStringArray *>(pvField)->view());
+    long length = putArrayLength(plan, xxx.size());
+    long size = dbChannelFinalFieldSize(plan.dbChan);
+    char *pv3 = static_cast<char *>(dbChannelField(plan.dbChan));
+    for(long i=0; i<length; i++) {
+        const char * const pxxx = xxx[i].data();
+        long strlen = xxx[i].length();
+        if (strlen > size) strlen = size;
+        for(long j=0; j<strlen; j++) pv3[j] = pxxx[j];
+        pv3 += size;
+    }
+    return true;
+}
+
+static bool putEnumValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    PVStructure *pvEnum = static_cast<PVStructure *>(pvField);
+    if (plan.enumIndexOffset) {
+        PVFieldPtr pvIndex = pvEnum->getSubField(
+            pvEnum->getFieldOffset() + plan.enumIndexOffset);
+        epicsEnum16 *value = static_cast<epicsEnum16*>(dbChannelField(plan.dbChan));
+        *value = static_cast<PVInt *>(pvIndex.get())->get();
+        return true;
+    }
+    PVStringArrayPtr pvChoices = pvEnum->getSubField<PVStringArray>("choices");
+    if (pvChoices.get())
+    {
+        requester->message("Can't change the choices field",errorMessage);
+    }
+    else
+    {
+        requester->message("Logic error. Putting to a enum subfield that's not index or choices", errorMessage);
+    }
+    return false;
+}
+
+static bool putMenuValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    if(requester) requester->message("Not allowed to change a menu field",errorMessage);
+    return true;
+}
+
+static bool putUnknownEnumValue(
+    DbAccessPlan const &plan,
+    Requester::shared_pointer const &requester,
+    PVField *pvField)
+{
+    if(requester) requester->message("Logic Error unknown enum field",errorMessage);
+    return false;
+}
+
 DbUtilPtr DbUtil::getDbUtil()
 {
     static DbUtilPtr util;
@@ -154,10 +533,42 @@ DbUtil::DbUtil()
       highAlarmLimitString("highAlarmLimit"),
       allString("value,timeStamp,alarm,display,control,valueAlarm"),
       indexString("index"),
-      choicesString("choices")
+      choicesString("choices"),
+      enumChoicesCache(&EnumChoicesCache::getEnumChoicesCache())
 {}
 
 int DbUtil::getProperties(
+        Requester::shared_pointer const &requester,
+        PVStructure::shared_pointer const &pvRequest,
+        dbChannel *dbChan,
+        bool processDefault)
+{
+    // everything of the field that findProperties looks at
+    char fieldKey[80];
+    dbCommon *precord = dbChannelRecord(dbChan);
+    epicsSnprintf(fieldKey, sizeof(fieldKey), "%s %d %d %d ",
+        precord->rdes ? precord->rdes->name : "",
+        (int)dbChannelFinalDBFType(dbChan),
+        (int)dbChannelSpecial(dbChan),
+        processDefault ? 1 : 0);
+    string key(fieldKey);
+    appendSignature(key, *pvRequest, true);
+    {
+        Lock xx(cacheMutex);
+        std::map<string,int>::const_iterator iter = propertiesCache.find(key);
+        if(iter!=propertiesCache.end()) return iter->second;
+    }
+    int propertyMask = findProperties(
+        requester, pvRequest, dbChan, processDefault);
+    // a failed request is not cached, so that it is reported every time
+    if(propertyMask==noAccessBit) return propertyMask;
+    Lock xx(cacheMutex);
+    if(propertiesCache.size()>=maxCacheEntries) propertiesCache.clear();
+    propertiesCache[key] = propertyMask;
+    return propertyMask;
+}
+
+int DbUtil::findProperties(
         Requester::shared_pointer const &requester,
         PVStructure::shared_pointer const &pvr,
         dbChannel *dbChan,
@@ -346,10 +757,57 @@ PVStructurePtr DbUtil::createPVStructure(
         Requester::shared_pointer const &requester, int propertyMask,
         dbChannel *dbChan, PVStructure::shared_pointer const &pvRequest)
 {
-    StandardPVFieldPtr standardPVField = getStandardPVField();
-    StandardFieldPtr standardField = getStandardField();
     PVDataCreatePtr pvDataCreate = getPVDataCreate();
-    FieldCreatePtr fieldCreate = getFieldCreate();
+
+    StructureConstPtr finalStructure;
+    ScalarType scalarType = (propertyMask&(enumValueBit|isLinkBit)) ?
+                pvString : getScalarType(requester,dbChan);
+    char maskKey[40];
+    epicsSnprintf(maskKey, sizeof(maskKey), "%d %d ",
+        propertyMask, (int)scalarType);
+    string key(maskKey);
+    // refineStructure only looks at the introspection of field
+    PVStructurePtr fieldPVStructure = pvRequest->getSubField<PVStructure>(fieldString);
+    if(fieldPVStructure.get()) {
+        appendSignature(key, *fieldPVStructure, false);
+    }
+    {
+        Lock xx(cacheMutex);
+        std::map<string,StructureConstPtr>::const_iterator iter =
+            structureCache.find(key);
+        if(iter!=structureCache.end()) finalStructure = iter->second;
+    }
+    if(!finalStructure) {
+        finalStructure = createStructure(
+            requester, propertyMask, dbChan, pvRequest);
+        if(!finalStructure) return nullPVStructure;
+        Lock xx(cacheMutex);
+        if(structureCache.size()>=maxCacheEntries) structureCache.clear();
+        structureCache[key] = finalStructure;
+    }
+
+    PVStructurePtr pvStructure = pvDataCreate->createPVStructure(finalStructure);
+
+
+    if((propertyMask&enumValueBit)!=0) {
+        PVStringArrayPtr pvChoices = pvStructure->getSubField<PVStringArray>(valueChoicesString);
+        if(pvChoices.get()) {
+            PVStringArray::const_svector choices;
+            if(!enumChoicesCache->getChoices(requester, dbChan,
+                    dbChannelFinalDBFType(dbChan), choices)) {
+                return nullPVStructure;
+            }
+            pvChoices->replace(choices);
+        }
+    }
+    return pvStructure;
+}
+
+StructureConstPtr DbUtil::createStructure(
+        Requester::shared_pointer const &requester, int propertyMask,
+        dbChannel *dbChan, PVStructure::shared_pointer const &pvRequest)
+{
+    StandardFieldPtr standardField = getStandardField();
 
     string properties;
     if((propertyMask&timeStampBit)!=0) properties+= timeStampString;
@@ -386,67 +844,253 @@ PVStructurePtr DbUtil::createPVStructure(
         else if((propertyMask & arrayValueBit)!=0)
             unrefinedStructure = standardField->scalarArray(scalarType,properties);
         else
-            return nullPVStructure;
+            return StructureConstPtr();
     }
 
-    PVStructurePtr fieldPVStructure = pvRequest->getSubField<PVStructure>("field"); 
-    StructureConstPtr finalStructure = fieldPVStructure.get() ?
+    PVStructurePtr fieldPVStructure = pvRequest->getSubField<PVStructure>(fieldString);
+    return fieldPVStructure.get() ?
         refineStructure(unrefinedStructure, fieldPVStructure->getStructure()) :
         unrefinedStructure;
+}
 
-    PVStructurePtr pvStructure = pvDataCreate->createPVStructure(finalStructure);
+DbAccessPlan::DbAccessPlan()
+: propertyMask(0),
+  dbChan(0),
+  scalarType(pvBoolean),
+  stringValueSize(0),
+  readValue(0),
+  getValue(0),
+  putValue(0),
+  getArrayInfo(0),
+  putArrayInfo(0),
+  getUnits(0),
+  getPrecision(0),
+  getGraphicDouble(0),
+  getControlDouble(0),
+  getAlarmDouble(0),
+  enumIndexOffset(0)
+{}
 
-    if((propertyMask&enumValueBit)!=0) {
-        struct dbr_enumStrs enumStrs;
-        rset *prset = dbGetRset(&dbChan->addr);
+DbAccessPlanPtr DbUtil::createAccessPlan(
+        Requester::shared_pointer const &requester,
+        int propertyMask,
+        dbChannel *dbChan,
+        PVStructurePtr const &pvStructure)
+{
+    DbAccessPlanPtr plan(new DbAccessPlan());
+    initAccessPlan(*plan, requester, propertyMask, dbChan, pvStructure);
+    return plan;
+}
 
-        PVStringArrayPtr pvChoices = pvStructure->getSubField<PVStringArray>(valueChoicesString);
-        if(pvChoices.get()) {
-            PVStringArray::svector choices;
-
-            if (dbChannelFinalDBFType(dbChan) == DBF_ENUM &&
-                    prset && prset->get_enum_strs) {
-                get_enum_strs get_strs;
-                get_strs = (get_enum_strs)(prset->get_enum_strs);
-                get_strs(&dbChan->addr, &enumStrs);
-                size_t length = enumStrs.no_str;
-                choices.reserve(length);
-                for(size_t i=0; i<length; i++)
-                    choices.push_back(enumStrs.strs[i]);
-            }
-            else if(dbChannelFinalDBFType(dbChan) == DBF_DEVICE) {
-                dbFldDes *pdbFldDes = dbChannelFldDes(dbChan);
-                dbDeviceMenu *pdbDeviceMenu
-                        = static_cast<dbDeviceMenu *>(pdbFldDes->ftPvt);
-                if(pdbDeviceMenu==NULL) {
-                    if(requester) requester->message(
-                                "record type has no device support", errorMessage);
-                    return nullPVStructure;
-                }
+void DbUtil::initAccessPlan(
+        DbAccessPlan &plan,
+        Requester::shared_pointer const &requester,
+        int propertyMask,
+        dbChannel *dbChan,
+        PVStructurePtr const &pvStructure)
+{
+    plan.propertyMask = propertyMask;
+    plan.dbChan = dbChan;
+    plan.pvStructure = pvStructure;
+    plan.scalarType = getScalarType(requester, dbChan);
+    if(plan.scalarType==pvString) {
+        // not MAX_STRING_SIZE, a DBF_STRING field can be longer
+        plan.stringValueSize = dbChannelFinalFieldSize(dbChan);
+        if(plan.stringValueSize==0) plan.stringValueSize = 1;
+    }
+    rset *prset = dbGetRset(&dbChan->addr);
+    if(prset) {
+        plan.getArrayInfo = (get_array_info)(prset->get_array_info);
+        plan.putArrayInfo = (put_array_info)(prset->put_array_info);
+        plan.getUnits = (get_units)(prset->get_units);
+        plan.getPrecision = (get_precision)(prset->get_precision);
+        plan.getGraphicDouble = (get_graphic_double)(prset->get_graphic_double);
+        plan.getControlDouble = (get_control_double)(prset->get_control_double);
+        plan.getAlarmDouble = (get_alarm_double)(prset->get_alarm_double);
+    }
+    if((propertyMask&getValueBit)!=0) {
+        createValueAccessors(plan, pvStructure->getPVFields()[0]);
+    }
+    if((propertyMask&enumValueBit)!=0
+    && dbChannelFinalDBFType(dbChan)==DBF_ENUM) {
+        plan.pvChoices = pvStructure->getSubField<PVStringArray>(valueChoicesString);
+    }
+    if((propertyMask&timeStampBit)!=0) {
+        PVStructurePtr pvField = pvStructure->getSubFieldT<PVStructure>(timeStampString);
+        plan.pvSecondsPastEpoch = pvField->getSubField<PVLong>("secondsPastEpoch");
+        plan.pvNanoseconds = pvField->getSubField<PVInt>("nanoseconds");
+    }
+    if((propertyMask&alarmBit)!=0) {
+        PVStructurePtr pvField = pvStructure->getSubFieldT<PVStructure>(alarmString);
+        plan.pvStatus = pvField->getSubField<PVInt>("status");
+        plan.pvSeverity = pvField->getSubField<PVInt>("severity");
+        plan.pvMessage = pvField->getSubField<PVString>("message");
+    }
+    if((propertyMask&displayBit)!=0) {
+        PVStructurePtr displayField = pvStructure->getSubFieldT<PVStructure>(displayString);
+        plan.pvUnits = displayField->getSubField<PVString>("units");
+        plan.pvFormat = displayField->getSubField<PVString>("format");
+        plan.pvDisplayLow = displayField->getSubField<PVDouble>("limitLow");
+        plan.pvDisplayHigh = displayField->getSubField<PVDouble>("limitHigh");
+    }
+    if((propertyMask&controlBit)!=0) {
+        PVStructurePtr controlField = pvStructure->getSubFieldT<PVStructure>(controlString);
+        plan.pvControlLow = controlField->getSubField<PVDouble>("limitLow");
+        plan.pvControlHigh = controlField->getSubField<PVDouble>("limitHigh");
+    }
+    if((propertyMask&valueAlarmBit)!=0) {
+        PVStructurePtr pvAlarmLimits =
+                pvStructure->getSubFieldT<PVStructure>(valueAlarmString);
+        plan.pvAlarmActive = pvAlarmLimits->getSubField<PVBoolean>("active");
+        plan.pvLowAlarmLimit = pvAlarmLimits->getSubField<PVScalar>(lowAlarmLimitString);
+        plan.pvLowWarningLimit = pvAlarmLimits->getSubField<PVScalar>(lowWarningLimitString);
+        plan.pvHighWarningLimit = pvAlarmLimits->getSubField<PVScalar>(highWarningLimitString);
+        plan.pvHighAlarmLimit = pvAlarmLimits->getSubField<PVScalar>(highAlarmLimitString);
+    }
+}
 
-                size_t length = pdbDeviceMenu->nChoice;
-                char **papChoice = pdbDeviceMenu->papChoice;
-                choices.reserve(length);
-                for(size_t i=0; i<length; i++)
-                    choices.push_back(papChoice[i]);
+void DbUtil::createValueAccessors(
+        DbAccessPlan &plan,
+        PVFieldPtr const &pvField)
+{
+    int propertyMask = plan.propertyMask;
+    plan.pvValue = pvField;
+    if((propertyMask&scalarValueBit)!=0) {
+        PVScalarPtr pvScalar = static_pointer_cast<PVScalar>(pvField);
+        switch(pvScalar->getScalar()->getScalarType()) {
+        case pvByte:
+            plan.readValue = readScalarValue<int8, &DbRecordData::byteValue, &CaData::byteValue>;
+            plan.getValue = getScalarValue<int8, &DbRecordData::byteValue>;
+            plan.putValue = putScalarValue<int8>;
+            break;
+        case pvUByte:
+            plan.readValue = readScalarValue<uint8, &DbRecordData::ubyteValue, &CaData::ubyteValue>;
+            plan.getValue = getScalarValue<uint8, &DbRecordData::ubyteValue>;
+            plan.putValue = putScalarValue<uint8>;
+            break;
+        case pvShort:
+            plan.readValue = readScalarValue<int16, &DbRecordData::shortValue, &CaData::shortValue>;
+            plan.getValue = getScalarValue<int16, &DbRecordData::shortValue>;
+            plan.putValue = putScalarValue<int16>;
+            break;
+        case pvUShort:
+            plan.readValue = readScalarValue<uint16, &DbRecordData::ushortValue, &CaData::ushortValue>;
+            plan.getValue = getScalarValue<uint16, &DbRecordData::ushortValue>;
+            plan.putValue = putScalarValue<uint16>;
+            break;
+        case pvInt:
+            plan.readValue = readScalarValue<int32, &DbRecordData::intValue, &CaData::intValue>;
+            plan.getValue = getScalarValue<int32, &DbRecordData::intValue>;
+            plan.putValue = putScalarValue<int32>;
+            break;
+        case pvUInt:
+            plan.readValue = readScalarValue<uint32, &DbRecordData::uintValue, &CaData::uintValue>;
+            plan.getValue = getScalarValue<uint32, &DbRecordData::uintValue>;
+            plan.putValue = putScalarValue<uint32>;
+            break;
+        case pvFloat:
+            plan.readValue = readScalarValue<float, &DbRecordData::floatValue, &CaData::floatValue>;
+            plan.getValue = getScalarValue<float, &DbRecordData::floatValue>;
+            plan.putValue = putScalarValue<float>;
+            break;
+        case pvDouble:
+            plan.readValue = readScalarValue<double, &DbRecordData::doubleValue, &CaData::doubleValue>;
+            plan.getValue = getScalarValue<double, &DbRecordData::doubleValue>;
+            plan.putValue = putScalarValue<double>;
+            break;
+        case pvString:
+            if(propertyMask&isLinkBit) {
+                plan.readValue = readLinkValue;
+                plan.getValue = getStringValue;
+            } else {
+                plan.readValue = readStringValue;
+                plan.getValue = getStringValue;
+            }
+            plan.putValue = putStringValue;
+            break;
+        default:
+            throw std::logic_error("Should never get here");
+        }
+    } else if((propertyMask&arrayValueBit)!=0) {
+        PVScalarArrayPtr pvArray = static_pointer_cast<PVScalarArray>(pvField);
+        switch(pvArray->getScalarArray()->getElementType()) {
+        case pvByte:
+            plan.readValue = readArrayValue<int8>;
+            plan.getValue = getArrayValue<int8>;
+            plan.putValue = putArrayValue<int8>;
+            break;
+        case pvUByte:
+            plan.readValue = readArrayValue<uint8>;
+            plan.getValue = getArrayValue<uint8>;
+            plan.putValue = putArrayValue<uint8>;
+            break;
+        case pvShort:
+            plan.readValue = readArrayValue<int16>;
+            plan.getValue = getArrayValue<int16>;
+            plan.putValue = putArrayValue<int16>;
+            break;
+        case pvUShort:
+            plan.readValue = readArrayValue<uint16>;
+            plan.getValue = getArrayValue<uint16>;
+            plan.putValue = putArrayValue<uint16>;
+            break;
+        case pvInt:
+            plan.readValue = readArrayValue<int32>;
+            plan.getValue = getArrayValue<int32>;
+            plan.putValue = putArrayValue<int32>;
+            break;
+        case pvUInt:
+            plan.readValue = readArrayValue<uint32>;
+            plan.getValue = getArrayValue<uint32>;
+            plan.putValue = putArrayValue<uint32>;
+            break;
+        case pvFloat:
+            plan.readValue = readArrayValue<float>;
+            plan.getValue = getArrayValue<float>;
+            plan.putValue = putArrayValue<float>;
+            break;
+        case pvDouble:
+            plan.readValue = readArrayValue<double>;
+            plan.getValue = getArrayValue<double>;
+            plan.putValue = putArrayValue<double>;
+            break;
+        case pvString:
+            plan.readValue = readStringArrayValue;
+            plan.getValue = getStringArrayValue;
+            plan.putValue = putStringArrayValue;
+            break;
+        default:
+            throw std::logic_error("Should never get here");
+        }
+    } else if((propertyMask&enumValueBit)!=0) {
+        PVStructurePtr pvEnum = static_pointer_cast<PVStructure>(pvField);
+        PVIntPtr pvIndex = pvEnum->getSubField<PVInt>(indexString);
+        plan.pvValue = pvIndex;
+        if(pvIndex.get()) {
+            plan.enumIndexOffset =
+                pvIndex->getFieldOffset() - pvEnum->getFieldOffset();
+        }
+        short dbfType = dbChannelFinalDBFType(plan.dbChan);
+        if(dbfType == DBF_DEVICE) {
+            if(pvIndex.get()) {
+                plan.readValue = readDeviceValue;
+                plan.getValue = getEnumValue;
             }
-            else if(dbChannelFinalDBFType(dbChan) == DBF_MENU) {
-                dbFldDes *pdbFldDes = dbChannelFldDes(dbChan);
-                dbMenu *pdbMenu = static_cast<dbMenu *>(pdbFldDes->ftPvt);
-                size_t length = pdbMenu->nChoice;
-                char **papChoice = pdbMenu->papChoiceValue;
-                choices.reserve(length);
-                for(size_t i=0; i<length; i++)
-                    choices.push_back(papChoice[i]);
+            plan.putValue = putEnumValue;
+        } else {
+            if(pvIndex.get()) {
+                plan.readValue = readEnumValue;
+                plan.getValue = getEnumValue;
             }
-            else {
-                if(requester) requester->message("bad enum field in V3 record",errorMessage);
-                return nullPVStructure;
+            if(dbfType == DBF_MENU) {
+                plan.putValue = putMenuValue;
+            } else if(dbfType == DBF_ENUM) {
+                plan.putValue = putEnumValue;
+            } else {
+                plan.putValue = putUnknownEnumValue;
             }
-            pvChoices->replace(freeze(choices));
         }
     }
-    return pvStructure;
 }
 
 void  DbUtil::getPropertyData(
@@ -456,73 +1100,87 @@ void  DbUtil::getPropertyData(
         PVStructurePtr const &pvStructure)
 {
     BitSet::shared_pointer bitSet;
-    getPropertyData(requester, propertyMask,
-        dbChan,pvStructure,bitSet);
+    DbAccessPlan plan;
+    initAccessPlan(plan, requester, propertyMask, dbChan, pvStructure);
+    DbRecordData data;
+    readPropertyData(plan, data);
+    getPropertyData(plan, data, bitSet);
+}
+
+void  DbUtil::readPropertyData(
+        DbAccessPlan const &plan,
+        DbRecordData &data)
+{
+    DBADDR *paddr = &plan.dbChan->addr;
+    if(plan.propertyMask&displayBit) {
+        if(plan.getUnits && plan.pvUnits.get()) {
+            plan.getUnits(paddr, data.units);
+            data.units[sizeof(data.units)-1] = 0;
+        }
+        if(plan.getPrecision && plan.pvFormat.get()) {
+            plan.getPrecision(paddr, &data.precision);
+        }
+        if(plan.getGraphicDouble) {
+            plan.getGraphicDouble(paddr, &data.graphics);
+        }
+    }
+    if((plan.propertyMask&controlBit) && plan.getControlDouble) {
+        plan.getControlDouble(paddr, &data.control);
+    }
+    if((plan.propertyMask&valueAlarmBit) && plan.getAlarmDouble) {
+        plan.getAlarmDouble(paddr, &data.alarmLimits);
+    }
 }
 
 void  DbUtil::getPropertyData(
-        Requester::shared_pointer const &requester,
-        int propertyMask,
-        dbChannel *dbChan,
-        PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         BitSet::shared_pointer const &bitSet)
 {
-        getDisplayData(requester, propertyMask, dbChan,
-            pvStructure, bitSet);
+        getDisplayData(plan, data, bitSet);
+
+        getControlData(plan, data, bitSet);
 
-        getControlData(requester, propertyMask, dbChan,
-            pvStructure, bitSet);
+        getValueAlarmData(plan, data, bitSet);
+}
 
-        getValueAlarmData(requester, propertyMask, dbChan,
-            pvStructure, bitSet);
+// Sets a limit of display or control if it changed
+static void putLimit(
+    PVDouble *pvLimit,
+    double limit,
+    BitSet::shared_pointer const &bitSet)
+{
+    if (!pvLimit || pvLimit->get() == limit) return;
+    pvLimit->put(limit);
+    if (bitSet.get())
+        bitSet->set(pvLimit->getFieldOffset());
 }
 
 void  DbUtil::getDisplayData(
-        Requester::shared_pointer const &requester,
-        int propertyMask,
-        dbChannel *dbChan,
-        PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         BitSet::shared_pointer const &bitSet)
 {
 
-    if(propertyMask&displayBit) {
-        PVStructurePtr displayField = pvStructure->getSubFieldT<PVStructure>(displayString);
-        char units[DB_UNITS_SIZE];
-        units[0] = 0;
-        long precision = 0;
-        rset *prset = dbGetRset(&dbChan->addr);
-        if(prset && prset->get_units) {
-            PVStringPtr unitsField = displayField->getSubField<PVString>("units");
-            if (unitsField.get()) {
-                get_units gunits;
-                gunits = (get_units)(prset->get_units);
-                gunits(&dbChan->addr,units);
-                string unitsString = string(units);
-                if (unitsString != unitsField->get()) {
-                    unitsField->put(unitsString);
-                    if (bitSet.get()) 
-                        bitSet->set(unitsField->getFieldOffset());
-                }
+    if(plan.propertyMask&displayBit) {
+        if(plan.getUnits && plan.pvUnits.get()) {
+            if (plan.pvUnits->get() != data.units) {
+                plan.pvUnits->put(string(data.units));
+                if (bitSet.get()) 
+                    bitSet->set(plan.pvUnits->getFieldOffset());
             }
         }
-        PVStringPtr formatField = displayField->getSubField<PVString>("format");
-        if (formatField.get()) {
+        if (plan.pvFormat.get()) {
             string format;
-            ScalarType scalarType = getScalarType(requester, dbChan);
+            ScalarType scalarType = plan.scalarType;
             if (scalarType == pvFloat || scalarType == pvDouble) {
-                if(prset && prset->get_precision) {
-                    get_precision gprec = (get_precision)(prset->get_precision);
-                    gprec(&dbChan->addr,&precision);
-                    if(precision>0) {
-                        char fmt[16];
-                        sprintf(fmt,"%%.%ldf",precision);
-                        format = string(fmt);
-                    } else {
-                        const static string defaultFormat("%f");
-                        format = defaultFormat;
-                    }
+                if(data.precision>0) {
+                    char fmt[16];
+                    sprintf(fmt,"%%.%ldf",data.precision);
+                    format = string(fmt);
                 } else {
-                    format="%f";
+                    const static string defaultFormat("%f");
+                    format = defaultFormat;
                 }
             } else if (scalarType == pvString)
                 format="%s";
@@ -532,438 +1190,160 @@ void  DbUtil::getDisplayData(
             } else {
                 format="%d";
             }
-            if (format != formatField->get()) {
-                formatField->put(format);
+            if (format != plan.pvFormat->get()) {
+                plan.pvFormat->put(format);
                 if (bitSet.get()) 
-                   bitSet->set(formatField->getFieldOffset());
+                   bitSet->set(plan.pvFormat->getFieldOffset());
             }
         }
-        struct dbr_grDouble graphics;
-        if(prset && prset->get_graphic_double) {
-            get_graphic_double gg =
-                    (get_graphic_double)(prset->get_graphic_double);
-            gg(&dbChan->addr,&graphics);
-
-            PVDoublePtr limitLowField = displayField->getSubField<PVDouble>("limitLow");
-            if (limitLowField.get() &&
-                    limitLowField->get() != graphics.lower_disp_limit) {
-                limitLowField->put(graphics.lower_disp_limit);
-                if (bitSet.get()) 
-                    bitSet->set(limitLowField->getFieldOffset());
-            }
-
-            PVDoublePtr limitHighField = displayField->getSubField<PVDouble>("limitHigh");
-            if (limitHighField.get() &&
-                    limitHighField->get() != graphics.upper_disp_limit) {
-                limitHighField->put(graphics.upper_disp_limit);
-                if (bitSet.get()) 
-                    bitSet->set(limitHighField->getFieldOffset());
-            }
+        if(plan.getGraphicDouble) {
+            putLimit(plan.pvDisplayLow.get(),
+                data.graphics.lower_disp_limit, bitSet);
+            putLimit(plan.pvDisplayHigh.get(),
+                data.graphics.upper_disp_limit, bitSet);
         }
     }
 }
 
 void  DbUtil::getControlData(
-        Requester::shared_pointer const &requester,
-        int propertyMask,
-        dbChannel *dbChan,
-        PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         BitSet::shared_pointer const &bitSet)
 {
-    if(propertyMask&controlBit) {
-        PVStructurePtr controlField = pvStructure->getSubFieldT<PVStructure>(controlString);
-        rset *prset = dbGetRset(&dbChan->addr);
-        struct dbr_ctrlDouble graphics;
-        memset(&graphics,0,sizeof(graphics));
-        if(prset && prset->get_control_double) {
-            get_control_double cc =
-                    (get_control_double)(prset->get_control_double);
-            cc(&dbChan->addr, &graphics);
-
-            PVDoublePtr limitLowField = controlField->getSubField<PVDouble>("limitLow");
-            if (limitLowField.get() &&
-                    limitLowField->get() != graphics.lower_ctrl_limit) {
-                limitLowField->put(graphics.lower_ctrl_limit);
-                if (bitSet.get()) 
-                    bitSet->set(limitLowField->getFieldOffset());
-            }
-
-            PVDoublePtr limitHighField = controlField->getSubField<PVDouble>("limitHigh");
-            if (limitHighField.get() &&
-                    limitHighField->get() != graphics.upper_ctrl_limit) {
-                limitHighField->put(graphics.upper_ctrl_limit);
-                if (bitSet.get()) 
-                    bitSet->set(limitHighField->getFieldOffset());
-            }
-        }
+    if((plan.propertyMask&controlBit) && plan.getControlDouble) {
+        putLimit(plan.pvControlLow.get(),
+            data.control.lower_ctrl_limit, bitSet);
+        putLimit(plan.pvControlHigh.get(),
+            data.control.upper_ctrl_limit, bitSet);
     }
 }
 
+// Sets an alarm limit, which may be of any scalar type
+static void putAlarmLimit(
+    PVScalarPtr const &pvScalar,
+    double limit,
+    BitSet::shared_pointer const &bitSet)
+{
+    if(pvScalar.get()==NULL) return;
+    if(getConvert()->toDouble(pvScalar) == limit) return;
+    getConvert()->fromDouble(pvScalar,limit);
+    if (bitSet.get())
+        bitSet->set(pvScalar->getFieldOffset());
+}
+
 void  DbUtil::getValueAlarmData(
-        Requester::shared_pointer const &requester,
-        int propertyMask,
-        dbChannel *dbChan,
-        PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         BitSet::shared_pointer const &bitSet)
 {
-    if(propertyMask&valueAlarmBit) {
-        rset *prset = dbGetRset(&dbChan->addr);
-        struct dbr_alDouble ald;
-        memset(&ald,0,sizeof(ald));
-        if(prset && prset->get_alarm_double) {
-            get_alarm_double cc =
-                    (get_alarm_double)(prset->get_alarm_double);
-            cc(&dbChan->addr,&ald);
-        }
-        PVStructurePtr pvAlarmLimits =
-                pvStructure->getSubFieldT<PVStructure>(valueAlarmString);
-        PVBooleanPtr pvActive = pvAlarmLimits->getSubField<PVBoolean>("active");
-        if(pvActive.get()!=NULL) pvActive->put(false);
-        PVScalarPtr pvScalar = pvAlarmLimits->getSubField<PVScalar>(lowAlarmLimitString);
-        if(pvScalar.get()!=NULL) {
-            double lowerAlarmLimit = getConvert()->toDouble(pvScalar);
-            if (lowerAlarmLimit != ald.lower_alarm_limit)
-            {
-                getConvert()->fromDouble(pvScalar,ald.lower_alarm_limit);
-                if (bitSet.get())
-                    bitSet->set(pvScalar->getFieldOffset());
-            }
-        }
-        pvScalar = pvAlarmLimits->getSubField<PVScalar>(lowWarningLimitString);
-        if(pvScalar.get()!=NULL) {
-            double lowerWarningLimit = getConvert()->toDouble(pvScalar);
-            if (lowerWarningLimit != ald.lower_warning_limit)
-            {
-                getConvert()->fromDouble(pvScalar,ald.lower_warning_limit);
-                if (bitSet.get())
-                    bitSet->set(pvScalar->getFieldOffset());
-            }
-        }
-        pvScalar = pvAlarmLimits->getSubField<PVScalar>(highWarningLimitString);
-        if(pvScalar.get()!=NULL) {
-            double higherAlarmWarning = getConvert()->toDouble(pvScalar);
-            if (higherAlarmWarning != ald.upper_warning_limit)
-            {
-                getConvert()->fromDouble(pvScalar,ald.upper_warning_limit);
-                if (bitSet.get())
-                    bitSet->set(pvScalar->getFieldOffset());
-            }
-        }
-        pvScalar = pvAlarmLimits->getSubField<PVScalar>(highAlarmLimitString);
-        if(pvScalar.get()!=NULL) {
-            double higherAlarmLimit = getConvert()->toDouble(pvScalar);
-            if (higherAlarmLimit != ald.upper_alarm_limit)
-            {
-                getConvert()->fromDouble(pvScalar,ald.upper_alarm_limit);
-                if (bitSet.get())
-                    bitSet->set(pvScalar->getFieldOffset());
-            }
-        }
+    if(plan.propertyMask&valueAlarmBit) {
+        const struct dbr_alDouble &ald = data.alarmLimits;
+        if(plan.pvAlarmActive.get()!=NULL) plan.pvAlarmActive->put(false);
+        putAlarmLimit(plan.pvLowAlarmLimit, ald.lower_alarm_limit, bitSet);
+        putAlarmLimit(plan.pvLowWarningLimit, ald.lower_warning_limit, bitSet);
+        putAlarmLimit(plan.pvHighWarningLimit, ald.upper_warning_limit, bitSet);
+        putAlarmLimit(plan.pvHighAlarmLimit, ald.upper_alarm_limit, bitSet);
     }
 }
 
+DbRecordData::DbRecordData()
+: doubleValue(0),
+  stringValue(1, 0),
+  timeStamp(),
+  status(0),
+  severity(0),
+  recordStat(0),
+  message(0),
+  readFailed(false),
+  precision(0),
+  stringSize(0)
+{
+    units[0] = 0;
+    memset(&graphics,0,sizeof(graphics));
+    memset(&control,0,sizeof(control));
+    memset(&alarmLimits,0,sizeof(alarmLimits));
+}
+
 Status  DbUtil::get(
         Requester::shared_pointer const &requester,
         int propertyMask,
         dbChannel *dbChan,
         PVStructurePtr const &pvStructure,
         BitSet::shared_pointer const &bitSet,
-        CaData *caData)
+        CaData *caData,
+        ArraySnapshotPool *arrayPool)
 {
-    if((propertyMask&getValueBit)!=0) {
-        PVFieldPtrArray pvFields = pvStructure->getPVFields();
-        PVFieldPtr pvField = pvFields[0];
-        if((propertyMask&scalarValueBit)!=0) {
-            PVScalarPtr pvScalar = static_pointer_cast<PVScalar>(pvField);
-            ScalarType scalarType = pvScalar->getScalar()->getScalarType();
-            bool wasChanged = false;
-            switch(scalarType) {
-            case pvByte: {
-                int8 val = 0;
-                if(caData) {
-                    val = caData->byteValue;
-                } else {
-                    val = *static_cast<int8 *>(dbChannelField(dbChan));
-                }
-                PVBytePtr pv = static_pointer_cast<PVByte>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvUByte: {
-                uint8 val = 0;
-                if(caData) {
-                    val = caData->ubyteValue;
-                } else {
-                    val = *static_cast<uint8 *>(dbChannelField(dbChan));
-                }
-                PVUBytePtr pv = static_pointer_cast<PVUByte>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvShort: {
-                int16 val = 0;
-                if(caData) {
-                    val = caData->shortValue;
-                } else {
-                    val = *static_cast<int16 *>(dbChannelField(dbChan));
-                }
-                PVShortPtr pv = static_pointer_cast<PVShort>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvUShort: {
-                uint16 val = 0;
-                if(caData) {
-                    val = caData->ushortValue;
-                } else {
-                    val = *static_cast<uint16 *>(dbChannelField(dbChan));
-                }
-                PVUShortPtr pv = static_pointer_cast<PVUShort>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvInt: {
-                int32 val = 0;
-                if(caData) {
-                    val = caData->intValue;
-                } else {
-                    val = *static_cast<int32 *>(dbChannelField(dbChan));
-                }
-                PVIntPtr pv = static_pointer_cast<PVInt>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvUInt: {
-                uint32 val = 0;
-                if(caData) {
-                    val = caData->uintValue;
-                } else {
-                    val = *static_cast<uint32 *>(dbChannelField(dbChan));
-                }
-                PVUIntPtr pv = static_pointer_cast<PVUInt>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvFloat: {
-                float val = 0;
-                if(caData) {
-                    val = caData->floatValue;
-                } else {
-                    val = *static_cast<float *>(dbChannelField(dbChan));
-                }
-                PVFloatPtr pv = static_pointer_cast<PVFloat>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvDouble: {
-                double val = 0;
-                if(caData) {
-                    val = caData->doubleValue;
-                } else {
-                    val = *static_cast<double *>(dbChannelField(dbChan));
-                }
-                PVDoublePtr pv = static_pointer_cast<PVDouble>(pvField);
-                if(pv->get()!=val) {
-                    pv->put(val);
-                    wasChanged = true;
-                }
-                break;
-            }
-            case pvString: {
-                char * val = 0;
-                if(propertyMask&isLinkBit) {
-                    char buffer[200];
-                    for(int i=0; i<200; i++) buffer[i]  = 0;
-                    long result = dbGetField(&dbChan->addr,DBR_STRING,
-                                             buffer,0,0,0);
-                    if(result!=0) {
-                        if(requester) requester->message("dbGetField error",errorMessage);
-                    }
-                    val = buffer;
-                } else {
-                    val = static_cast<char *>(dbChannelField(dbChan));
-                }
-                string sval(val);
-                PVStringPtr pvString = static_pointer_cast<PVString>(pvField);
-                if(pvString->get().empty()) {
-                    pvString->put(sval);
-                    wasChanged = true;
-                } else {
-                    if((pvString->get().compare(sval))!=0) {
-                        pvString->put(sval);
-                        wasChanged = true;
-                    }
-                }
-                break;
-            }
-            default:
-                throw std::logic_error("Should never get here");
-            }
-            if(wasChanged) bitSet->set(pvField->getFieldOffset());
-        } else if((propertyMask&arrayValueBit)!=0) {
-            PVScalarArrayPtr pvArray = static_pointer_cast<PVScalarArray>(pvField);
-            ScalarType scalarType = pvArray->getScalarArray()->getElementType();
-            long rec_length = 0;
-            long rec_offset = 0;
-            rset *prset = dbGetRset(&dbChan->addr);
-            get_array_info get_info;
-            get_info = (get_array_info)(prset->get_array_info);
-            get_info(&dbChan->addr, &rec_length, &rec_offset);
-            if(rec_offset!=0) {
-                throw std::logic_error("Can't handle offset != 0");
-            }
-            size_t length = rec_length;
-
-            switch(scalarType) {
-            case pvByte: {
-                shared_vector<int8> xxx(length);
-                int8 *pv3 = static_cast<int8 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const int8> data(freeze(xxx));
-                PVByteArrayPtr pva = static_pointer_cast<PVByteArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvUByte: {
-                shared_vector<uint8> xxx(length);
-                uint8 *pv3 = static_cast<uint8 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const uint8> data(freeze(xxx));
-                PVUByteArrayPtr pva = static_pointer_cast<PVUByteArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvShort: {
-                shared_vector<int16> xxx(length);
-                int16 *pv3 = static_cast<int16 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const int16> data(freeze(xxx));
-                PVShortArrayPtr pva = static_pointer_cast<PVShortArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvUShort: {
-                shared_vector<uint16> xxx(length);
-                uint16 *pv3 = static_cast<uint16 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const uint16> data(freeze(xxx));
-                PVUShortArrayPtr pva = static_pointer_cast<PVUShortArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvInt: {
-                shared_vector<int32> xxx(length);
-                int32 *pv3 = static_cast<int32 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const int32> data(freeze(xxx));
-                PVIntArrayPtr pva = static_pointer_cast<PVIntArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvUInt: {
-                shared_vector<uint32> xxx(length);
-                uint32 *pv3 = static_cast<uint32 *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const uint32> data(freeze(xxx));
-                PVUIntArrayPtr pva = static_pointer_cast<PVUIntArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvFloat: {
-                shared_vector<float> xxx(length);
-                float *pv3 = static_cast<float *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const float> data(freeze(xxx));
-                PVFloatArrayPtr pva = static_pointer_cast<PVFloatArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvDouble: {
-                shared_vector<double> xxx(length);
-                double *pv3 = static_cast<double *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) xxx[i] = pv3[i];
-                shared_vector<const double> data(freeze(xxx));
-                PVDoubleArrayPtr pva = static_pointer_cast<PVDoubleArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            case pvString: {
-                shared_vector<string> xxx(length);
-                char *pv3 = static_cast<char *>(dbChannelField(dbChan));
-                for(size_t i=0; i<length; i++) {
-                    xxx[i] = pv3;
-                    pv3 += dbChannelFinalFieldSize(dbChan);
-                }
-                shared_vector<const string> data(freeze(xxx));
-                PVStringArrayPtr pva = static_pointer_cast<PVStringArray>(pvArray);
-                pva->replace(data);
-                break;
-            }
-            default:
-                throw std::logic_error("Should never get here");
-            }
-            bitSet->set(pvField->getFieldOffset());
-        } else if((propertyMask&enumValueBit)!=0) {
-            int32 val = 0;
-            if(caData) {
-                val = caData->intValue;
-            } else {
-                if (dbChannelFinalDBFType(dbChan) == DBF_DEVICE) {
-                    val = static_cast<epicsEnum16>(dbChannelRecord(dbChan)->dtyp);
-                } else {
-                    val = static_cast<int32>(*static_cast<epicsEnum16 *>(dbChannelField(dbChan)));
-                }
-            }
-            PVStructurePtr pvEnum = static_pointer_cast<PVStructure>(pvField);
-            PVIntPtr pvIndex = pvEnum->getSubField<PVInt>(indexString);
-            if(pvIndex.get() && pvIndex->get()!=val) {
-                pvIndex->put(val);
-                bitSet->set(pvIndex->getFieldOffset());
-            }
-        }
+    DbAccessPlan plan;
+    initAccessPlan(plan, requester, propertyMask, dbChan, pvStructure);
+    return get(requester, plan, bitSet, caData, arrayPool);
+}
+
+Status  DbUtil::get(
+        Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        BitSet::shared_pointer const &bitSet,
+        CaData *caData,
+        ArraySnapshotPool *arrayPool)
+{
+    DbRecordData data;
+    readRecord(plan, data, caData, arrayPool);
+    return get(requester, plan, bitSet, data);
+}
+
+void  DbUtil::readRecord(
+        DbAccessPlan const &plan,
+        DbRecordData &data,
+        CaData *caData,
+        ArraySnapshotPool *arrayPool)
+{
+    struct dbCommon *precord = dbChannelRecord(plan.dbChan);
+    if(plan.readValue) plan.readValue(plan, data, caData, arrayPool);
+
+    if((plan.propertyMask&timeStampBit)!=0) {
+        data.timeStamp = caData ? caData->timeStamp : precord->time;
     }
 
-    if((propertyMask&timeStampBit)!=0)
-    {
-        PVStructurePtr pvField = pvStructure->getSubFieldT<PVStructure>(timeStampString);
-        epicsTimeStamp *epicsTimeStamp;
-        struct dbCommon *precord = dbChannelRecord(dbChan);
+    if((plan.propertyMask&alarmBit)!=0) {
         if(caData) {
-            epicsTimeStamp = &caData->timeStamp;
+            data.status = caData->stat;
+            data.severity = caData->sevr;
+            data.message = &caData->status;
         } else {
-                epicsTimeStamp = &precord->time;     
+            data.status = dbrStatus2alarmStatus[precord->stat];
+            data.severity = precord->sevr;
+            data.recordStat = precord->stat;
+            data.message = 0;
         }
-        PVLongPtr pvSecs = pvField->getSubField<PVLong>("secondsPastEpoch");
-        if (pvSecs.get()) {
+    }
+
+    readPropertyData(plan, data);
+}
+
+Status  DbUtil::get(
+        Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        BitSet::shared_pointer const &bitSet,
+        DbRecordData const &data)
+{
+    if(plan.getValue && plan.getValue(plan, requester, data)) {
+        bitSet->set(plan.pvValue->getFieldOffset());
+    }
+
+    getChoices(requester, plan, bitSet);
+
+    if((plan.propertyMask&timeStampBit)!=0)
+    {
+        const epicsTimeStamp *epicsTimeStamp = &data.timeStamp;
+        PVLong *pvSecs = plan.pvSecondsPastEpoch.get();
+        if (pvSecs) {
             int64 seconds  = epicsTimeStamp->secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH;
             if(seconds != pvSecs->get()) {
                 pvSecs->put(seconds);
                 bitSet->set(pvSecs->getFieldOffset());
             }
         }
-        PVIntPtr pvNsecs = pvField->getSubField<PVInt>("nanoseconds");
-        if (pvNsecs.get()) {
+        PVInt *pvNsecs = plan.pvNanoseconds.get();
+        if (pvNsecs) {
             int32 nanoseconds= epicsTimeStamp->nsec;
             if(nanoseconds != pvNsecs->get()) {
                 pvNsecs->put(nanoseconds);
@@ -972,47 +1352,73 @@ Status  DbUtil::get(
         }
     }
 
-    if((propertyMask&alarmBit)!=0) {
-        PVStructurePtr pvField = pvStructure->getSubFieldT<PVStructure>(alarmString);
-        struct dbCommon *precord = dbChannelRecord(dbChan);
-        string message;
-        epicsEnum16 stat;
-        epicsEnum16 sevr;
-        if(caData) {
-            message = caData->status;
-            stat = caData->stat;
-            sevr = caData->sevr;
-        } else {
-            message = dbrStatus2alarmMessage[precord->stat];
-            stat = dbrStatus2alarmStatus[precord->stat];
-            sevr = precord->sevr;
-        }
-
-        PVIntPtr pvStatus = pvField->getSubField<PVInt>("status");
-        if (pvStatus.get() && stat != pvStatus->get()) {
-            pvStatus->put(stat);
+    if((plan.propertyMask&alarmBit)!=0) {
+        PVInt *pvStatus = plan.pvStatus.get();
+        if (pvStatus && data.status != pvStatus->get()) {
+            pvStatus->put(data.status);
             bitSet->set(pvStatus->getFieldOffset());
         }
 
-        PVIntPtr pvSeverity = pvField->getSubField<PVInt>("severity");
-        if (pvSeverity.get() && sevr != pvSeverity->get()) {
-            pvSeverity->put(sevr);
+        PVInt *pvSeverity = plan.pvSeverity.get();
+        if (pvSeverity && data.severity != pvSeverity->get()) {
+            pvSeverity->put(data.severity);
             bitSet->set(pvSeverity->getFieldOffset());
         }
 
-        PVStringPtr pvMessage = pvField->getSubField<PVString>("message");
-        if (pvMessage.get() && message != pvMessage->get()) {
-            pvMessage->put(message);
-            bitSet->set(pvMessage->getFieldOffset());
+        PVString *pvMessage = plan.pvMessage.get();
+        if (pvMessage) {
+            string message;
+            if(data.message) {
+                message = *data.message;
+            } else {
+                message = dbrStatus2alarmMessage[data.recordStat];
+            }
+            if (message != pvMessage->get()) {
+                pvMessage->put(message);
+                bitSet->set(pvMessage->getFieldOffset());
+            }
         }
     }
 
-    getPropertyData(requester, propertyMask, dbChan,
-        pvStructure, bitSet);
+    getPropertyData(plan, data, bitSet);
 
     return Status::Ok;
 }
 
+void  DbUtil::readRecordProperties(
+        DbAccessPlan const &plan,
+        DbRecordData &data)
+{
+    readPropertyData(plan, data);
+}
+
+Status  DbUtil::getRecordProperties(
+        Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        BitSet::shared_pointer const &bitSet,
+        DbRecordData const &data)
+{
+    getChoices(requester, plan, bitSet);
+    getPropertyData(plan, data, bitSet);
+    return Status::Ok;
+}
+
+void  DbUtil::getChoices(
+        Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        BitSet::shared_pointer const &bitSet)
+{
+    if(!plan.pvChoices) return;
+    // a new vector only after a DBE_PROPERTY event of the field
+    PVStringArray::const_svector choices;
+    if(enumChoicesCache->getChoices(requester, plan.dbChan,
+            DBF_ENUM, choices)
+    && choices.data()!=plan.pvChoices->view().data()) {
+        plan.pvChoices->replace(choices);
+        bitSet->set(plan.pvChoices->getFieldOffset());
+    }
+}
+
 Status  DbUtil::put(
         Requester::shared_pointer const &requester,
         int propertyMask,
@@ -1023,201 +1429,33 @@ Status  DbUtil::put(
         if(requester) requester->message("Logic Error unknown field to put",errorMessage);
         return Status::Ok;
     }
+    DbAccessPlan plan;
+    plan.propertyMask = propertyMask;
+    plan.dbChan = dbChan;
+    rset *prset = dbGetRset(&dbChan->addr);
+    if(prset) plan.putArrayInfo = (put_array_info)(prset->put_array_info);
+    createValueAccessors(plan, pvField);
+    return put(requester, plan, pvField);
+}
 
-    if((propertyMask&scalarValueBit)!=0) {
-        PVScalarPtr pvScalar = static_pointer_cast<PVScalar>(pvField);
-        ScalarType scalarType = pvScalar->getScalar()->getScalarType();
-        switch(scalarType) {
-        case pvByte: {
-            int8 * val = static_cast<int8 *>(dbChannelField(dbChan));
-            PVBytePtr pv = static_pointer_cast<PVByte>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvUByte: {
-            uint8 * val = static_cast<uint8 *>(dbChannelField(dbChan));
-            PVUBytePtr pv = static_pointer_cast<PVUByte>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvShort: {
-            int16 * val = static_cast<int16 *>(dbChannelField(dbChan));
-            PVShortPtr pv = static_pointer_cast<PVShort>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvUShort: {
-            uint16 * val = static_cast<uint16 *>(dbChannelField(dbChan));
-            PVUShortPtr pv = static_pointer_cast<PVUShort>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvInt: {
-            int32 * val = static_cast<int32 *>(dbChannelField(dbChan));
-            PVIntPtr pv = static_pointer_cast<PVInt>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvUInt: {
-            uint32 * val = static_cast<uint32 *>(dbChannelField(dbChan));
-            PVUIntPtr pv = static_pointer_cast<PVUInt>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvFloat: {
-            float * val = static_cast<float *>(dbChannelField(dbChan));
-            PVFloatPtr pv = static_pointer_cast<PVFloat>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvDouble: {
-            double * val = static_cast<double *>(dbChannelField(dbChan));
-            PVDoublePtr pv = static_pointer_cast<PVDouble>(pvField);
-            *val = pv->get();
-            break;
-        }
-        case pvString: {
-            char * to = static_cast<char *>(dbChannelField(dbChan));
-            PVStringPtr pvString = static_pointer_cast<PVString>(pvField);
-            if(pvString->get().empty()) {
-                *(to) = 0;
-            } else {
-                int size = dbChannelFinalFieldSize(dbChan)-1;
-                int fromLen = pvString->get().length();
-                if(fromLen<size) size = fromLen;
-                strncpy(to,pvString->get().c_str(),size);
-                *(to + size) = 0;
-            }
-            break;
-        }
-        default:
-            if(requester) requester->message("Logic Error did not handle scalarType",errorMessage);
-            return Status::Ok;
-        }
-    } else if((propertyMask&arrayValueBit)!=0) {
-        PVScalarArrayPtr pvArray = static_pointer_cast<PVScalarArray>(pvField);
-        ScalarType scalarType = pvArray->getScalarArray()->getElementType();
-        long no_elements  = dbChannelFinalElements(dbChan);
-        long length = pvArray->getLength();
-        if(length>no_elements) length = no_elements;
-        rset *prset = dbGetRset(&dbChan->addr);
-        if(prset && prset->put_array_info) {
-            put_array_info put_info;
-            put_info = (put_array_info)(prset->put_array_info);
-            put_info(&dbChan->addr, length);
-        }
-        switch(scalarType) {
-        case pvByte: {
-            PVByteArrayPtr pva = static_pointer_cast<PVByteArray>(pvArray);
-            PVByteArray::const_svector xxx = pva->view();
-            int8 *pv3 = static_cast<int8 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvUByte: {
-            PVUByteArrayPtr pva = static_pointer_cast<PVUByteArray>(pvArray);
-            PVUByteArray::const_svector xxx = pva->view();
-            uint8 *pv3 = static_cast<uint8 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvShort: {
-            PVShortArrayPtr pva = static_pointer_cast<PVShortArray>(pvArray);
-            PVShortArray::const_svector xxx = pva->view();
-            int16 *pv3 = static_cast<int16 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvUShort: {
-            PVUShortArrayPtr pva = static_pointer_cast<PVUShortArray>(pvArray);
-            PVUShortArray::const_svector xxx = pva->view();
-            uint16 *pv3 = static_cast<uint16 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvInt: {
-            PVIntArrayPtr pva = static_pointer_cast<PVIntArray>(pvArray);
-            PVIntArray::const_svector xxx = pva->view();
-            int32 *pv3 = static_cast<int32 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvUInt: {
-            PVUIntArrayPtr pva = static_pointer_cast<PVUIntArray>(pvArray);
-            PVUIntArray::const_svector xxx = pva->view();
-            uint32 *pv3 = static_cast<uint32 *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvFloat: {
-            PVFloatArrayPtr pva = static_pointer_cast<PVFloatArray>(pvArray);
-            PVFloatArray::const_svector xxx = pva->view();
-            float *pv3 = static_cast<float *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvDouble: {
-            PVDoubleArrayPtr pva = static_pointer_cast<PVDoubleArray>(pvArray);
-            PVDoubleArray::const_svector xxx = pva->view();
-            double *pv3 = static_cast<double *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) pv3[i] = xxx[i];
-            break;
-        }
-        case pvString: {
-            PVStringArrayPtr pva = static_pointer_cast<PVStringArray>(pvArray);
-            PVStringArray::const_svector xxx = pva->view();
-            char *pv3 = static_cast<char *>(dbChannelField(dbChan));
-            for(long i=0; i<length; i++) {
-                const char * const pxxx = xxx[i].data();
-                long strlen = xxx[i].length();
-                if (strlen > dbChannelFinalFieldSize(dbChan))
-                    strlen = dbChannelFinalFieldSize(dbChan);
-                for(long j=0; j<strlen; j++) pv3[j] = pxxx[j];
-                pv3 += dbChannelFinalFieldSize(dbChan);
-            }
-            break;
-        }
-        default:
-            throw std::logic_error("Should never get here");
-        }
-    } else if((propertyMask&enumValueBit)!=0) {
-        PVIntPtr pvIndex;
-        PVStructurePtr pvEnum = static_pointer_cast<PVStructure>(pvField);
-        pvIndex = pvEnum->getSubField<PVInt>(indexString);
-
-        if(dbChannelFinalDBFType(dbChan) == DBF_MENU) {
-            if(requester) requester->message("Not allowed to change a menu field",errorMessage);
-        } else if(dbChannelFinalDBFType(dbChan) == DBF_ENUM || dbChannelFinalDBFType(dbChan) == DBF_DEVICE) {
-            epicsEnum16 *value = static_cast<epicsEnum16*>(dbChannelField(dbChan));
-            if (pvIndex.get()) {
-               *value = pvIndex->get();
-            }
-            else {
-                PVStringArrayPtr pvChoices = pvEnum->getSubField<PVStringArray>(choicesString);
-                if (pvChoices.get())
-                {
-                    requester->message("Can't change the choices field",errorMessage);
-                }
-                else
-                {
-                    requester->message("Logic error. Putting to a enum subfield that's not index or choices", errorMessage);
-                }
-                return Status::Ok;
-            }
-        } else {
-            if(requester) requester->message("Logic Error unknown enum field",errorMessage);
-            return Status::Ok;
-        }
-    } else {
+Status  DbUtil::put(
+        Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        PVFieldPtr const &pvField)
+{
+    if(!plan.putValue) {
         if(requester) requester->message("Logic Error unknown field to put",errorMessage);
         return Status::Ok;
     }
+    if(!plan.putValue(plan, requester, pvField.get())) return Status::Ok;
+
+    dbChannel *dbChan = plan.dbChan;
     dbCommon *precord = dbChannelRecord(dbChan);
     dbFldDes *pfldDes = dbChannelFldDes(dbChan);
     int isValueField = dbIsValueField(pfldDes);
     if(isValueField) precord->udf = 0;
     bool post = false;
-    if(!(propertyMask&processBit)) post = true;
+    if(!(plan.propertyMask&processBit)) post = true;
     if(precord->mlis.count && !(isValueField && pfldDes->process_passive)) post = true;
     if(post) {
         db_post_events(precord, dbChannelField(dbChan), DBE_VALUE | DBE_LOG);
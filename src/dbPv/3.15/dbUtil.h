@@ -11,6 +11,7 @@
 
 #include <string>
 #include <cstring>
+#include <map>
 
 #include <dbAccess.h>
 #include <dbCommon.h>
@@ -22,8 +23,10 @@
 #include <pv/requester.h>
 #include <pv/pvIntrospect.h>
 #include <pv/pvData.h>
+#include <pv/lock.h>
 
 #include "dbPv.h"
+#include "dbRecordData.h"
 
 namespace epics { namespace pvaSrv { 
 
@@ -39,7 +42,84 @@ typedef long (*get_alarm_double) (DBADDR *, struct dbr_alDouble  *);
 }
 
 class DbUtil;
+class DbAccessPlan;
+class ArraySnapshotPool;
+class EnumChoicesCache;
 typedef std::tr1::shared_ptr<DbUtil> DbUtilPtr;
+typedef std::tr1::shared_ptr<DbAccessPlan> DbAccessPlanPtr;
+
+/* The accessors used by DbUtil::get and DbUtil::put for one channel and
+ * one pvStructure, resolved once by DbUtil::createAccessPlan.
+ * With a plan get and put neither look up sub-fields by name nor switch
+ * on the scalar type. A field pointer is null if the field is not part
+ * of pvStructure. The plan holds a reference to pvStructure.
+ */
+class DbAccessPlan {
+public:
+    POINTER_DEFINITIONS(DbAccessPlan);
+    // copies the value from the record (or caData) into data,
+    // called with the record locked
+    typedef void (*ReadValue)(
+        DbAccessPlan const &plan,
+        DbRecordData &data,
+        CaData *caData,
+        ArraySnapshotPool *arrayPool);
+    // converts the value of data into pvValue, returns true if it changed
+    typedef bool (*GetValue)(
+        DbAccessPlan const &plan,
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbRecordData const &data);
+    // copies the value from pvField, which has the type of pvValue,
+    // into the record, returns false if nothing was written
+    typedef bool (*PutValue)(
+        DbAccessPlan const &plan,
+        epics::pvData::Requester::shared_pointer const &requester,
+        epics::pvData::PVField *pvField);
+
+    DbAccessPlan();
+    int propertyMask;
+    dbChannel *dbChan;
+    epics::pvData::PVStructurePtr pvStructure;
+    epics::pvData::ScalarType scalarType;   // of the DBF type
+    size_t stringValueSize;   // bytes of a DBF_STRING value
+    ReadValue readValue;
+    GetValue getValue;
+    PutValue putValue;
+    // record support
+    get_array_info getArrayInfo;
+    put_array_info putArrayInfo;
+    get_units getUnits;
+    get_precision getPrecision;
+    get_graphic_double getGraphicDouble;
+    get_control_double getControlDouble;
+    get_alarm_double getAlarmDouble;
+    // value, or value.index of an enum
+    epics::pvData::PVFieldPtr pvValue;
+    size_t enumIndexOffset;   // of index relative to the enum structure
+    // value.choices of a DBF_ENUM, whose choices can change
+    epics::pvData::PVStringArrayPtr pvChoices;
+    // timeStamp
+    epics::pvData::PVLongPtr pvSecondsPastEpoch;
+    epics::pvData::PVIntPtr pvNanoseconds;
+    // alarm
+    epics::pvData::PVIntPtr pvStatus;
+    epics::pvData::PVIntPtr pvSeverity;
+    epics::pvData::PVStringPtr pvMessage;
+    // display
+    epics::pvData::PVStringPtr pvUnits;
+    epics::pvData::PVStringPtr pvFormat;
+    epics::pvData::PVDoublePtr pvDisplayLow;
+    epics::pvData::PVDoublePtr pvDisplayHigh;
+    // control
+    epics::pvData::PVDoublePtr pvControlLow;
+    epics::pvData::PVDoublePtr pvControlHigh;
+    // valueAlarm
+    epics::pvData::PVBooleanPtr pvAlarmActive;
+    epics::pvData::PVScalarPtr pvLowAlarmLimit;
+    epics::pvData::PVScalarPtr pvLowWarningLimit;
+    epics::pvData::PVScalarPtr pvHighWarningLimit;
+    epics::pvData::PVScalarPtr pvHighAlarmLimit;
+};
 
 class DbUtil {
 public:
@@ -65,6 +145,10 @@ public:
     int dbPutBit;         // Must call dbPutField
     int isLinkBit;        // field is a DBF_XXLINK field
 
+    /* getProperties and createPVStructure remember their result for
+     * each pvRequest and kind of field, so identical requests, for
+     * example from many clients reconnecting, are parsed only once.
+     */
     int getProperties(
         epics::pvData::Requester::shared_pointer const &requester,
         epics::pvData::PVStructure::shared_pointer const &pvRequest,
@@ -78,12 +162,60 @@ public:
         epics::pvData::Requester::shared_pointer const &requester,
         int mask, dbChannel *dbChan,
         epics::pvData::PVStructurePtr const &pvStructure);
+    /* Called once per operation, for example in init.
+     * The plan is valid as long as dbChan and pvStructure are.
+     */
+    DbAccessPlanPtr createAccessPlan(
+        epics::pvData::Requester::shared_pointer const &requester,
+        int mask, dbChannel *dbChan,
+        epics::pvData::PVStructurePtr const &pvStructure);
+    /* Copies the data of the record, which must be locked, or of
+     * caV3Data if not null, that get converts.
+     */
+    void readRecord(
+        DbAccessPlan const &plan,
+        DbRecordData &data,
+        CaData *caV3Data,
+        ArraySnapshotPool *arrayPool = 0);
+    /* Converts data into plan.pvStructure, without the record lock */
+    epics::pvData::Status get(
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        epics::pvData::BitSet::shared_pointer const &bitSet,
+        DbRecordData const &data);
+    /* For a DBE_PROPERTY event: copies only the display, control and
+     * valueAlarm data of the record, which must be locked
+     */
+    void readRecordProperties(
+        DbAccessPlan const &plan,
+        DbRecordData &data);
+    /* Converts what readRecordProperties copied, and the choices of an
+     * enum, without the record lock
+     */
+    epics::pvData::Status getRecordProperties(
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        epics::pvData::BitSet::shared_pointer const &bitSet,
+        DbRecordData const &data);
+    /* readRecord and get, with the record locked */
+    epics::pvData::Status get(
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        epics::pvData::BitSet::shared_pointer const &bitSet,
+        CaData *caV3Data,
+        ArraySnapshotPool *arrayPool = 0);
+    epics::pvData::Status put(
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        epics::pvData::PVFieldPtr const &pvField);
+    /* The following create a plan for each call */
     epics::pvData::Status get(
         epics::pvData::Requester::shared_pointer const &requester,
         int mask, dbChannel *dbChan,
         epics::pvData::PVStructurePtr const &pvStructure,
         epics::pvData::BitSet::shared_pointer const &bitSet,
-        CaData *caV3Data);
+        CaData *caV3Data,
+        ArraySnapshotPool *arrayPool = 0);
     epics::pvData::Status put(
         epics::pvData::Requester::shared_pointer const &requester,
         int mask, dbChannel *dbChan,
@@ -98,35 +230,59 @@ public:
 private:
     DbUtil();
 
-    void getPropertyData(
+    int findProperties(
         epics::pvData::Requester::shared_pointer const &requester,
-        int mask,
+        epics::pvData::PVStructure::shared_pointer const &pvRequest,
         dbChannel *dbChan,
-        epics::pvData::PVStructurePtr const &pvStructure,
+        bool processDefault);
+    epics::pvData::StructureConstPtr createStructure(
+        epics::pvData::Requester::shared_pointer const &requester,
+        int mask, dbChannel *dbChan,
+        epics::pvData::PVStructure::shared_pointer const &pvRequest);
+
+    void initAccessPlan(
+        DbAccessPlan &plan,
+        epics::pvData::Requester::shared_pointer const &requester,
+        int mask, dbChannel *dbChan,
+        epics::pvData::PVStructurePtr const &pvStructure);
+    void createValueAccessors(
+        DbAccessPlan &plan,
+        epics::pvData::PVFieldPtr const &pvField);
+
+    void readPropertyData(
+        DbAccessPlan const &plan,
+        DbRecordData &data);
+
+    void getChoices(
+        epics::pvData::Requester::shared_pointer const &requester,
+        DbAccessPlan const &plan,
+        epics::pvData::BitSet::shared_pointer const &bitSet);
+
+    void getPropertyData(
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         epics::pvData::BitSet::shared_pointer const &bitSet);
 
     void getDisplayData(
-        epics::pvData::Requester::shared_pointer const &requester,
-        int mask,
-        dbChannel *dbChan,
-        epics::pvData::PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         epics::pvData::BitSet::shared_pointer const &bitSet);
 
     void getControlData(
-        epics::pvData::Requester::shared_pointer const &requester,
-        int mask,
-        dbChannel *dbChan,
-        epics::pvData::PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         epics::pvData::BitSet::shared_pointer const &bitSet);
 
     void getValueAlarmData(
-        epics::pvData::Requester::shared_pointer const &requester,
-        int mask,
-        dbChannel *dbChan,
-        epics::pvData::PVStructurePtr const &pvStructure,
+        DbAccessPlan const &plan,
+        DbRecordData const &data,
         epics::pvData::BitSet::shared_pointer const &bitSet);
 
     epics::pvData::PVStructurePtr  nullPVStructure;
+    // keyed by the signature of the field and the pvRequest
+    epics::pvData::Mutex cacheMutex;
+    std::map<std::string,int> propertiesCache;
+    std::map<std::string,epics::pvData::StructureConstPtr> structureCache;
     std::string recordString;
     std::string processString;
     std::string blockString;
@@ -147,6 +303,7 @@ private:
     std::string allString;
     std::string indexString;
     std::string choicesString;
+    EnumChoicesCache *enumChoicesCache;
 };
 
 }}
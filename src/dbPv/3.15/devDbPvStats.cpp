@@ -0,0 +1,100 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* ai device support that reads a counter or histogram of DbPvStats,
+ * so that the dbPv provider serves them as PVs. For example:
+ *
+ * record(ai, "$(P)getLock:p99") {
+ *     field(DTYP, "dbPvStats")
+ *     field(INP, "@getLock p99")
+ *     field(SCAN, "1 second")
+ * }
+ *
+ * INP is "@<counter>" or "@<histogram> <count|mean|max|p50|p99>".
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include <alarm.h>
+#include <dbAccess.h>
+#include <devSup.h>
+#include <recGbl.h>
+#include <aiRecord.h>
+
+#define epicsExportSharedSymbols
+
+#include <epicsExport.h>
+#include "dbPvStats.h"
+
+using namespace epics::pvaSrv;
+using std::string;
+
+struct StatsPvt {
+    bool isCounter;
+    DbPvStats::Counter counter;
+    DbPvStats::Histogram histogram;
+    DbPvStats::Statistic statistic;
+};
+
+static long initRecord(void *record)
+{
+    aiRecord *prec = static_cast<aiRecord *>(record);
+    if(prec->inp.type!=INST_IO) {
+        recGblRecordError(S_db_badField, prec, "devAiDbPvStats: INP not INST_IO");
+        return S_db_badField;
+    }
+    char name[40] = "";
+    char statistic[16] = "count";
+    sscanf(prec->inp.value.instio.string, "%39s %15s", name, statistic);
+    StatsPvt pvt;
+    pvt.isCounter = DbPvStats::findCounter(name, pvt.counter);
+    if(!pvt.isCounter) {
+        if(!DbPvStats::findHistogram(name, pvt.histogram)
+        || !DbPvStats::findStatistic(statistic, pvt.statistic)) {
+            recGblRecordError(S_db_badField, prec, "devAiDbPvStats: bad INP");
+            return S_db_badField;
+        }
+    }
+    prec->dpvt = new StatsPvt(pvt);
+    return 0;
+}
+
+static long readAi(void *record)
+{
+    aiRecord *prec = static_cast<aiRecord *>(record);
+    StatsPvt *pvt = static_cast<StatsPvt *>(prec->dpvt);
+    if(!pvt) return 2;
+    if(pvt->isCounter) {
+        prec->val = static_cast<double>(DbPvStats::getCount(pvt->counter));
+    } else {
+        prec->val = DbPvStats::getStatistic(pvt->histogram, pvt->statistic);
+    }
+    prec->udf = 0;
+    // do not convert
+    return 2;
+}
+
+static struct {
+    long number;
+    DEVSUPFUN report;
+    DEVSUPFUN init;
+    DEVSUPFUN init_record;
+    DEVSUPFUN get_ioint_info;
+    DEVSUPFUN read_ai;
+    DEVSUPFUN special_linconv;
+} devAiDbPvStats = {
+    6,
+    0,
+    0,
+    (DEVSUPFUN)initRecord,
+    0,
+    (DEVSUPFUN)readAi,
+    0
+};
+
+extern "C" {
+    epicsExportAddress(dset, devAiDbPvStats);
+}
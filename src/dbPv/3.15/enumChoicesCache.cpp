@@ -0,0 +1,190 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The choices of enum, menu and device fields, read once and shared
+ * by every PVStructure with a value.choices field.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include <dbAccess.h>
+#include <dbChannel.h>
+#include <dbEvent.h>
+#include <dbStaticLib.h>
+
+#include <pv/pvData.h>
+#include <pv/lock.h>
+
+#define epicsExportSharedSymbols
+
+#include "dbPvTrace.h"
+#include "dbUtil.h"
+#include "dbEventMonitor.h"
+#include "enumChoicesCache.h"
+
+using namespace epics::pvData;
+using std::string;
+
+namespace epics { namespace pvaSrv {
+
+extern "C" {
+
+static void enumPropertyCallback(void *userArg, struct dbChannel *chan,
+    int eventsRemaining, struct db_field_log *pfl)
+{
+    DBPV_TRACE(monitorTrace, 1, "enumPropertyCallback");
+    EnumChoicesCache::getEnumChoicesCache().refresh(userArg);
+}
+
+} //extern "C"
+
+static void readEnumStrs(dbChannel *dbChan, PVStringArray::svector &choices)
+{
+    rset *prset = dbGetRset(&dbChan->addr);
+    if(!prset || !prset->get_enum_strs) return;
+    struct dbr_enumStrs enumStrs;
+    get_enum_strs get_strs = (get_enum_strs)(prset->get_enum_strs);
+    get_strs(&dbChan->addr, &enumStrs);
+    size_t length = enumStrs.no_str;
+    choices.reserve(length);
+    for(size_t i=0; i<length; i++)
+        choices.push_back(enumStrs.strs[i]);
+}
+
+EnumChoicesCache &EnumChoicesCache::getEnumChoicesCache()
+{
+    // never deleted, the subscriptions are kept until the IOC exits
+    static EnumChoicesCache *cache = 0;
+    static Mutex mutex;
+    Lock xx(mutex);
+
+    if(!cache) cache = new EnumChoicesCache();
+    return *cache;
+}
+
+bool EnumChoicesCache::getChoices(
+    Requester::shared_pointer const &requester,
+    dbChannel *dbChan,
+    short dbfType,
+    PVStringArray::const_svector &choices)
+{
+    void *key = 0;
+    dbFldDes *pdbFldDes = dbChannelFldDes(dbChan);
+    if(dbfType==DBF_ENUM) {
+        key = dbChannelField(dbChan);
+    } else if(dbfType==DBF_DEVICE || dbfType==DBF_MENU) {
+        key = pdbFldDes->ftPvt;
+    }
+    {
+        Lock xx(mutex);
+        EntryMap::const_iterator iter = entries.find(key);
+        if(iter!=entries.end()) {
+            choices = iter->second.choices;
+            return true;
+        }
+    }
+    PVStringArray::svector newChoices;
+    Entry entry;
+    entry.dbChan = 0;
+    entry.evsub = 0;
+    bool isCached = true;
+    if(dbfType==DBF_ENUM) {
+        // subscribe first, so that no change after the read is missed;
+        // without a subscription the choices are not cached
+        isCached = subscribe(key, entry, dbChan);
+        readEnumStrs(dbChan, newChoices);
+    } else if(dbfType==DBF_DEVICE) {
+        dbDeviceMenu *pdbDeviceMenu = static_cast<dbDeviceMenu *>(key);
+        if(pdbDeviceMenu==NULL) {
+            if(requester) requester->message(
+                        "record type has no device support", errorMessage);
+            return false;
+        }
+        size_t length = pdbDeviceMenu->nChoice;
+        char **papChoice = pdbDeviceMenu->papChoice;
+        newChoices.reserve(length);
+        for(size_t i=0; i<length; i++)
+            newChoices.push_back(papChoice[i]);
+    } else if(dbfType==DBF_MENU) {
+        dbMenu *pdbMenu = static_cast<dbMenu *>(key);
+        size_t length = pdbMenu->nChoice;
+        char **papChoice = pdbMenu->papChoiceValue;
+        newChoices.reserve(length);
+        for(size_t i=0; i<length; i++)
+            newChoices.push_back(papChoice[i]);
+    } else {
+        if(requester) requester->message("bad enum field in V3 record",errorMessage);
+        return false;
+    }
+    choices = freeze(newChoices);
+    if(!isCached) return true;
+    entry.choices = choices;
+    bool isNew = true;
+    {
+        Lock xx(mutex);
+        std::pair<EntryMap::iterator,bool> result =
+            entries.insert(EntryMap::value_type(key, entry));
+        if(!result.second) {
+            isNew = false;
+            choices = result.first->second.choices;
+        }
+    }
+    // another thread cached the field first
+    if(!isNew && entry.evsub) {
+        db_cancel_event(entry.evsub);
+        dbChannelDelete(entry.dbChan);
+    }
+    return true;
+}
+
+// The subscription is enabled before any monitor of the field can
+// subscribe. Both use the same event task, which therefore refreshes
+// the choices before the monitors get the DBE_PROPERTY event.
+bool EnumChoicesCache::subscribe(void *key, Entry &entry, dbChannel *dbChan)
+{
+    dbEventCtx context = getDbEventContext();
+    if(context==0) return false;
+    // a channel of its own, without the filters of dbChan
+    string name(dbChannelRecord(dbChan)->name);
+    name += '.';
+    name += dbChannelFldDes(dbChan)->name;
+    entry.dbChan = dbChannelCreate(name.c_str());
+    if(!entry.dbChan) return false;
+    if(dbChannelOpen(entry.dbChan)) {
+        dbChannelDelete(entry.dbChan);
+        entry.dbChan = 0;
+        return false;
+    }
+    entry.evsub = db_add_event(context, entry.dbChan,
+        enumPropertyCallback, key, DBE_PROPERTY);
+    if(entry.evsub==0) {
+        dbChannelDelete(entry.dbChan);
+        entry.dbChan = 0;
+        return false;
+    }
+    db_event_enable(entry.evsub);
+    return true;
+}
+
+void EnumChoicesCache::refresh(void *key)
+{
+    dbChannel *dbChan = 0;
+    {
+        Lock xx(mutex);
+        EntryMap::const_iterator iter = entries.find(key);
+        if(iter==entries.end()) return;
+        dbChan = iter->second.dbChan;
+    }
+    if(!dbChan) return;
+    PVStringArray::svector choices;
+    dbScanLock(dbChannelRecord(dbChan));
+    readEnumStrs(dbChan, choices);
+    dbScanUnlock(dbChannelRecord(dbChan));
+    Lock xx(mutex);
+    entries[key].choices = freeze(choices);
+}
+
+}}
@@ -0,0 +1,60 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The choices of enum, menu and device fields, read once and shared
+ * by every PVStructure with a value.choices field.
+ *
+ * Menu and device choices are fixed by the database definition.
+ * The strings of a DBF_ENUM field (e.g. ZRST... of mbbi) can change;
+ * the record then posts DBE_PROPERTY on the field, upon which the
+ * cache reads them again.
+ */
+
+#ifndef ENUMCHOICESCACHE_H
+#define ENUMCHOICESCACHE_H
+
+#include <map>
+
+#include <dbChannel.h>
+#include <dbEvent.h>
+
+#include <pv/pvData.h>
+#include <pv/requester.h>
+#include <pv/lock.h>
+#include <pv/noDefaultMethods.h>
+
+namespace epics { namespace pvaSrv {
+
+class EnumChoicesCache : private epics::pvData::NoDefaultMethods {
+public:
+    static EnumChoicesCache &getEnumChoicesCache();
+    /* Sets choices to the current choices of the field of dbChan.
+     * Returns false, after telling requester why, if it has none.
+     * Two calls return the same vector until the choices change.
+     */
+    bool getChoices(
+        epics::pvData::Requester::shared_pointer const &requester,
+        dbChannel *dbChan,
+        short dbfType,
+        epics::pvData::PVStringArray::const_svector &choices);
+    /* Called for a DBE_PROPERTY event of an enum field */
+    void refresh(void *key);
+private:
+    EnumChoicesCache() {}
+    ~EnumChoicesCache() {}
+    struct Entry {
+        epics::pvData::PVStringArray::const_svector choices;
+        dbChannel *dbChan;          // only for DBF_ENUM
+        dbEventSubscription evsub;  // only for DBF_ENUM
+    };
+    bool subscribe(void *key, Entry &entry, dbChannel *dbChan);
+    // the field of a DBF_ENUM, else the dbMenu or dbDeviceMenu
+    typedef std::map<void *,Entry> EntryMap;
+    EntryMap entries;
+    epics::pvData::Mutex mutex;
+};
+
+}}
+
+#endif  /* ENUMCHOICESCACHE_H */
@@ -0,0 +1,257 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* A single producer, single consumer queue of monitor elements
+ * that needs no lock.
+ *
+ * The queue owns a fixed array of N elements, used as a ring.
+ * Three cursors run from 0 to 2N-1 and then wrap, so that a full queue
+ * can be told from an empty one and no cursor ever overflows:
+ *   head      - index of the element the producer is filling (current).
+ *               Written by the producer only.
+ *   tail      - index of the oldest element not yet released by the
+ *               consumer or dropped by the producer. Written by whichever
+ *               side owns the element at tail.
+ *   pollIndex - index of the next element to poll.
+ *               Private to the consumer, which also counts the elements
+ *               it holds. While it holds none the producer may drop
+ *               elements, so pollIndex is then taken from tail.
+ * Elements [tail,head) are queued, the element at head is owned by the
+ * producer, all others are free.
+ * Each element also has a state word, which both sides change with
+ * compare and swap: queued, polled (owned by the consumer), busy (taken
+ * back by the producer) or free. The word also holds the cursor the
+ * element was queued at, so that a consumer that read tail before the
+ * producer dropped that element and queued its slot again does not
+ * claim the newer element in its place.
+ *
+ * Producer:
+ *   getCurrent() returns the element to fill.
+ *   getNext() returns the free element following current or null if the
+ *   queue is full. The producer may write to it before calling publish().
+ *   publish() hands current to the consumer and makes next current.
+ *   getCurrentIndex(), getNextIndex() and getLastIndex() give the position
+ *   in the array passed to setElements() of current, next and the newest
+ *   queued element.
+ *   When the queue is full the producer can take back an element that has
+ *   not been polled yet:
+ *   reclaimLast() takes the newest queued element, which must be given
+ *   back with requeueLast().
+ *   dropOldest() takes the oldest queued element and frees its slot,
+ *   so that the following getNext() returns it.
+ * Consumer:
+ *   poll() returns the oldest queued element not yet polled, or null.
+ *   Null is also returned while the producer has taken the element back;
+ *   the producer notifies the consumer again when it is done.
+ *   release() must be called for polled elements in the order polled.
+ *
+ * Ownership changes are stored and observed with compare and swap, which
+ * is a full barrier: the old owner's reads and writes of the element are
+ * complete before the new owner sees the cursor or state, and the new
+ * owner's accesses do not start before it has seen it. Read and write
+ * barriers alone do not order the old owner's reads before the new
+ * owner's writes.
+ * reset() must only be called while neither side is active.
+ */
+
+#ifndef MONITORELEMENTQUEUE_H
+#define MONITORELEMENTQUEUE_H
+
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+#include <epicsAtomic.h>
+
+#include <pv/monitor.h>
+
+/* Called by poll between reading tail and claiming the element,
+ * a test can define it to run the producer in that window.
+ */
+#ifndef MONITOR_QUEUE_POLL_HOOK
+#define MONITOR_QUEUE_POLL_HOOK()
+#endif
+
+namespace epics { namespace pvaSrv {
+
+class MonitorElementQueue {
+public:
+    MonitorElementQueue()
+    : limit(0), head(0), tail(0), pollIndex(0), numberPolled(0)
+    {}
+    /* Must be called before use with at least two elements */
+    void setElements(epics::pvData::MonitorElementPtrArray const & array)
+    {
+        if(array.size()<2) throw std::logic_error(
+            "MonitorElementQueue needs at least two elements");
+        elements = array;
+        states.resize(elements.size());
+        limit = 2*elements.size();
+        reset();
+    }
+    void reset()
+    {
+        head = tail = pollIndex = numberPolled = 0;
+        for(size_t i=0; i<states.size(); i++) states[i] = slotFree;
+        epicsAtomicWriteMemoryBarrier();
+    }
+    size_t capacity() const { return elements.size(); }
+
+    // producer side
+
+    epics::pvData::MonitorElementPtr const & getCurrent() const
+    {
+        return elements[slot(head)];
+    }
+    size_t getCurrentIndex() const { return slot(head); }
+    epics::pvData::MonitorElementPtr const & getNext() const
+    {
+        size_t released = load(tail);
+        if(distance(released, head)+1>=elements.size()) return nullElement;
+        return elements[slot(advance(head))];
+    }
+    size_t getNextIndex() const { return slot(advance(head)); }
+    /* Only valid after getNext() returned an element */
+    void publish()
+    {
+        setState(slot(head), head, slotQueued);
+        store(head, head, advance(head));
+    }
+    epics::pvData::MonitorElementPtr const & reclaimLast()
+    {
+        if(head==epicsAtomicGetSizeT(&tail)) return nullElement;
+        size_t cursor = retreat(head);
+        if(!take(cursor)) return nullElement;
+        return elements[slot(cursor)];
+    }
+    size_t getLastIndex() const { return slot(retreat(head)); }
+    void requeueLast()
+    {
+        setState(slot(retreat(head)), retreat(head), slotQueued);
+    }
+    epics::pvData::MonitorElementPtr const & dropOldest()
+    {
+        size_t oldest = epicsAtomicGetSizeT(&tail);
+        if(head==oldest) return nullElement;
+        if(!take(oldest)) return nullElement;
+        size_t first = slot(oldest);
+        // the consumer does not write tail while it owns no element
+        setState(first, oldest, slotFree);
+        store(tail, oldest, advance(oldest));
+        return elements[first];
+    }
+    /* number of elements waiting for the consumer */
+    size_t getNumberUsed() const
+    {
+        return distance(epicsAtomicGetSizeT(&tail), head);
+    }
+
+    // consumer side
+
+    epics::pvData::MonitorElementPtr const & poll()
+    {
+        while(true) {
+            // the producer can only drop elements while the consumer
+            // holds none, and dropped elements are skipped
+            size_t released = pollIndex;
+            if(numberPolled==0) {
+                released = load(tail);
+                pollIndex = released;
+            }
+            size_t published = load(head);
+            if(pollIndex==published) return nullElement;
+            MONITOR_QUEUE_POLL_HOOK();
+            size_t next = slot(pollIndex);
+            size_t queued = stateWord(pollIndex, slotQueued);
+            size_t state = epicsAtomicCmpAndSwapSizeT(
+                &states[next], queued, stateWord(pollIndex, slotPolled));
+            if(state==queued) {
+                pollIndex = advance(pollIndex);
+                numberPolled++;
+                return elements[next];
+            }
+            // producer has the element, retry only if it was dropped
+            if(numberPolled>0) return nullElement;
+            if(epicsAtomicGetSizeT(&tail)==released) return nullElement;
+        }
+    }
+    void release(epics::pvData::MonitorElementPtr const & element)
+    {
+        size_t released = epicsAtomicGetSizeT(&tail);
+        size_t first = slot(released);
+        if(numberPolled==0 || element!=elements[first]) {
+            throw std::logic_error(
+                "not queueElement returned by last call to getUsed");
+        }
+        // the consumer is done with the element before it is reused
+        setState(first, released, slotFree);
+        store(tail, released, advance(released));
+        numberPolled--;
+    }
+private:
+    enum {slotFree, slotQueued, slotPolled, slotBusy, numberStates};
+    enum {cacheLineSize = 64};
+    size_t slot(size_t index) const
+    {
+        return index<elements.size() ? index : index-elements.size();
+    }
+    size_t advance(size_t index) const
+    {
+        return index+1==limit ? 0 : index+1;
+    }
+    size_t retreat(size_t index) const
+    {
+        return index==0 ? limit-1 : index-1;
+    }
+    size_t distance(size_t from, size_t to) const
+    {
+        return to>=from ? to-from : to+limit-from;
+    }
+    static size_t stateWord(size_t cursor, size_t state)
+    {
+        return cursor*numberStates + state;
+    }
+    // takes the element queued at cursor back from the consumer
+    bool take(size_t cursor)
+    {
+        size_t queued = stateWord(cursor, slotQueued);
+        size_t state = epicsAtomicCmpAndSwapSizeT(
+            &states[slot(cursor)], queued, stateWord(cursor, slotBusy));
+        return state==queued;
+    }
+    // by the side that owns the element, the other side only swaps
+    // a queued state, so the loaded word is the one replaced
+    void setState(size_t index, size_t cursor, size_t state)
+    {
+        size_t &word = states[index];
+        epicsAtomicCmpAndSwapSizeT(&word, load(word), stateWord(cursor, state));
+    }
+    // epicsAtomic has a full barrier only with compare and swap.
+    // A swap of 0 for 0 loads without changing the value.
+    static size_t load(size_t const & value)
+    {
+        return epicsAtomicCmpAndSwapSizeT(const_cast<size_t *>(&value), 0, 0);
+    }
+    // Only the owner writes value, so it always holds expected
+    static void store(size_t & value, size_t expected, size_t newValue)
+    {
+        epicsAtomicCmpAndSwapSizeT(&value, expected, newValue);
+    }
+    epics::pvData::MonitorElementPtrArray elements;
+    std::vector<size_t> states;
+    epics::pvData::MonitorElementPtr nullElement;
+    size_t limit;
+    // keep the cursors written by each side in separate cache lines
+    char pad0[cacheLineSize];
+    size_t head;
+    char pad1[cacheLineSize-sizeof(size_t)];
+    size_t tail;
+    size_t pollIndex;
+    size_t numberPolled;
+    char pad2[cacheLineSize-3*sizeof(size_t)];
+};
+
+}}
+
+#endif  /* MONITORELEMENTQUEUE_H */
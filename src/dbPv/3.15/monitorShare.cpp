@@ -0,0 +1,279 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* A database subscription shared by all monitors of the same channel
+ * that request the same fields.
+ * On each event the record data is converted once into a PVStructure
+ * owned by the share, which every started monitor then copies.
+ */
+
+#include <cstddef>
+#include <string>
+#include <cstdio>
+#include <map>
+
+#include <dbAccess.h>
+#include <dbChannel.h>
+
+#include <pv/pvData.h>
+#include <pv/lock.h>
+
+#define epicsExportSharedSymbols
+
+#include "dbEventMonitor.h"
+#include "dbUtil.h"
+#include "monitorShare.h"
+#include "dbPvStats.h"
+
+using namespace epics::pvData;
+using std::string;
+
+namespace epics { namespace pvaSrv {
+
+// All shares by channel name. A share removes itself when its last
+// client detaches, so every entry refers to a live share.
+typedef std::multimap<string, MonitorShare *> ShareMap;
+static ShareMap shareMap;
+static Mutex shareMapMutex;
+
+MonitorShare::shared_pointer MonitorShare::attach(
+    std::tr1::shared_ptr<DbPvMonitor> const &client,
+    string const &channelName,
+    int propertyMask,
+    unsigned dbeMask,
+    CaType caType,
+    int queueSize,
+    PVStructurePtr const &pvStructure)
+{
+    Lock xx(shareMapMutex);
+    StructureConstPtr structure = pvStructure->getStructure();
+    std::pair<ShareMap::iterator, ShareMap::iterator> range =
+        shareMap.equal_range(channelName);
+    for(ShareMap::iterator iter=range.first; iter!=range.second; ++iter) {
+        MonitorShare *share = iter->second;
+        if(share->propertyMask!=propertyMask) continue;
+        if(share->dbeMask!=dbeMask) continue;
+        if(!(*share->pvStructure->getStructure()==*structure)) continue;
+        share->addClient(client, queueSize);
+        return share->getPtrSelf();
+    }
+    shared_pointer share(new MonitorShare(
+        channelName, propertyMask, dbeMask, caType, pvStructure));
+    if(!share->connect()) return shared_pointer();
+    share->addClient(client, queueSize);
+    shareMap.insert(ShareMap::value_type(channelName, share.get()));
+    return share;
+}
+
+MonitorShare::MonitorShare(
+    string const &channelName,
+    int propertyMask,
+    unsigned dbeMask,
+    CaType caType,
+    PVStructurePtr const &pvStructure)
+: dbUtil(DbUtil::getDbUtil()),
+  channelName(channelName),
+  propertyMask(propertyMask),
+  dbeMask(dbeMask),
+  caType(caType),
+  dbChan(0),
+  dbEventMonitor(),
+  pvStructure(getPVDataCreate()->createPVStructure(pvStructure)),
+  changedBitSet(new BitSet(pvStructure->getNumberFields())),
+  numberStarted(0),
+  numberElements(0)
+{
+    DBPV_TRACE(monitorTrace, 1, "monitorShare::monitorShare");
+}
+
+MonitorShare::~MonitorShare()
+{
+    DBPV_TRACE(monitorTrace, 1, "monitorShare::~monitorShare");
+    dbEventMonitor.reset();
+    if(dbChan) dbChannelDelete(dbChan);
+}
+
+bool MonitorShare::connect()
+{
+    // the share outlives the DbPv of the client that created it
+    dbChan = dbChannelCreate(channelName.c_str());
+    if(!dbChan) return false;
+    if(dbChannelOpen(dbChan)) return false;
+    accessPlan = dbUtil->createAccessPlan(
+        getPtrSelf(), propertyMask, dbChan, pvStructure);
+    dbEventMonitor.reset(
+        new DbEventMonitor(getPtrSelf(), dbChan, caType, dbeMask));
+    dbEventMonitor->connect();
+    if(!dbEventMonitor->isConnected()) {
+        dbEventMonitor.reset();
+        return false;
+    }
+    return true;
+}
+
+void MonitorShare::addClient(
+    std::tr1::shared_ptr<DbPvMonitor> const &client,
+    int queueSize)
+{
+    Lock xx(mutex);
+    Client entry;
+    entry.monitor = client;
+    entry.queueSize = queueSize;
+    entry.isStarted = false;
+    clients.push_back(entry);
+    numberElements += queueSize;
+    // every client element may hold a snapshot, plus the one being filled
+    if(propertyMask&dbUtil->arrayValueBit) {
+        arrayPool.setCapacity(numberElements+1);
+    }
+}
+
+void MonitorShare::detach(DbPvMonitor *client)
+{
+    DBPV_TRACE(monitorTrace, 1, "monitorShare::detach");
+    bool isLast = false;
+    {
+        Lock xx(shareMapMutex);
+        Lock yy(mutex);
+        for(size_t i=0; i<clients.size(); i++) {
+            if(clients[i].monitor.get()!=client) continue;
+            if(clients[i].isStarted) numberStarted--;
+            numberElements -= clients[i].queueSize;
+            clients.erase(clients.begin()+i);
+            break;
+        }
+        if(clients.empty()) {
+            isLast = true;
+            std::pair<ShareMap::iterator, ShareMap::iterator> range =
+                shareMap.equal_range(channelName);
+            for(ShareMap::iterator iter=range.first; iter!=range.second; ++iter) {
+                if(iter->second!=this) continue;
+                shareMap.erase(iter);
+                break;
+            }
+        }
+    }
+    if(!isLast) return;
+    // waits for an event in progress, then breaks the reference cycle
+    dbEventMonitor->cancel();
+    dbEventMonitor.reset();
+}
+
+void MonitorShare::start(DbPvMonitor *client)
+{
+    Lock xx(mutex);
+    bool found = false;
+    for(size_t i=0; i<clients.size(); i++) {
+        if(clients[i].monitor.get()!=client) continue;
+        if(clients[i].isStarted) return;
+        clients[i].isStarted = true;
+        numberStarted++;
+        found = true;
+        break;
+    }
+    if(!found || !dbEventMonitor) return;
+    if(numberStarted==1) {
+        // also posts an event, which gives the client its initial update
+        dbEventMonitor->start();
+        return;
+    }
+    // an event would also update the started clients, so only this
+    // client is given the current data of the record
+    if(!startPlan) {
+        startStructure = getPVDataCreate()->createPVStructure(pvStructure);
+        startPlan = dbUtil->createAccessPlan(
+            getPtrSelf(), propertyMask, dbChan, startStructure);
+        startBitSet.reset(new BitSet(startStructure->getNumberFields()));
+    }
+    startBitSet->clear();
+    dbScanLock(dbChannelRecord(dbChan));
+    DbPvTimer timer;
+    dbUtil->readRecord(*startPlan, startData, 0);
+    dbScanUnlock(dbChannelRecord(dbChan));
+    timer.lap(DbPvStats::monitorLockHistogram);
+    dbUtil->get(getPtrSelf(), *startPlan, startBitSet, startData);
+    timer.stop(DbPvStats::monitorConvertHistogram);
+    // the client is still in its firstTime and copies all of startStructure
+    client->sharedEvent(startStructure, *startBitSet);
+}
+
+void MonitorShare::stop(DbPvMonitor *client)
+{
+    Lock xx(mutex);
+    for(size_t i=0; i<clients.size(); i++) {
+        if(clients[i].monitor.get()!=client) continue;
+        if(!clients[i].isStarted) return;
+        clients[i].isStarted = false;
+        numberStarted--;
+        break;
+    }
+    if(numberStarted==0 && dbEventMonitor) dbEventMonitor->stop();
+}
+
+string MonitorShare::getRequesterName()
+{
+    return channelName;
+}
+
+void MonitorShare::message(string const &message,MessageType messageType)
+{
+    Lock xx(mutex);
+    for(size_t i=0; i<clients.size(); i++) {
+        clients[i].monitor->message(message, messageType);
+    }
+}
+
+void MonitorShare::exceptionCallback(long status,long op)
+{}
+
+void MonitorShare::connectionCallback()
+{}
+
+void MonitorShare::accessRightsCallback()
+{}
+
+void MonitorShare::eventCallback(const char *status)
+{
+    DBPV_TRACE(monitorTrace, 2, "monitorShare::eventCallback");
+    Lock xx(mutex);
+    if(numberStarted==0 || !dbEventMonitor) return;
+    changedBitSet->clear();
+    if(dbEventMonitor->isPropertyEvent()) {
+        // the value, alarm and timeStamp come with the other events
+        dbScanLock(dbChannelRecord(dbChan));
+        DbPvTimer timer;
+        dbUtil->readRecordProperties(*accessPlan, recordData);
+        dbScanUnlock(dbChannelRecord(dbChan));
+        timer.lap(DbPvStats::monitorLockHistogram);
+        dbUtil->getRecordProperties(
+            getPtrSelf(),
+            *accessPlan,
+            changedBitSet,
+            recordData);
+        timer.stop(DbPvStats::monitorConvertHistogram);
+        if(changedBitSet->nextSetBit(0)<0) return;
+    } else {
+        dbScanLock(dbChannelRecord(dbChan));
+        DbPvTimer timer;
+        dbUtil->readRecord(
+            *accessPlan,
+            recordData,
+            dbEventMonitor->getData(),
+            &arrayPool);
+        dbScanUnlock(dbChannelRecord(dbChan));
+        timer.lap(DbPvStats::monitorLockHistogram);
+        Status stat = dbUtil->get(
+            getPtrSelf(),
+            *accessPlan,
+            changedBitSet,
+            recordData);
+        timer.stop(DbPvStats::monitorConvertHistogram);
+    }
+    for(size_t i=0; i<clients.size(); i++) {
+        if(!clients[i].isStarted) continue;
+        clients[i].monitor->sharedEvent(pvStructure, *changedBitSet);
+    }
+}
+
+}}
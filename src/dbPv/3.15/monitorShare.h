@@ -0,0 +1,111 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* A database subscription shared by all monitors of the same channel
+ * that request the same fields.
+ * On each event the record data is converted once into a PVStructure
+ * owned by the share, which every started monitor then copies.
+ */
+
+#ifndef MONITORSHARE_H
+#define MONITORSHARE_H
+
+#include <string>
+#include <vector>
+
+#include <dbChannel.h>
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/lock.h>
+
+#include "dbPv.h"
+#include "arraySnapshotPool.h"
+
+namespace epics { namespace pvaSrv {
+
+class MonitorShare;
+typedef std::tr1::shared_ptr<MonitorShare> MonitorSharePtr;
+
+class MonitorShare :
+    public virtual CaMonitorRequester,
+    public std::tr1::enable_shared_from_this<MonitorShare>
+{
+public:
+    POINTER_DEFINITIONS(MonitorShare);
+    /* Attaches client to the share for channelName, propertyMask,
+     * the DBE_XXX events of dbeMask and the structure of pvStructure,
+     * which is created if it does not exist.
+     * pvStructure is also the initial data of a new share.
+     * queueSize is the number of elements the client has.
+     * Returns null if the channel can not be monitored.
+     */
+    static shared_pointer attach(
+        std::tr1::shared_ptr<DbPvMonitor> const &client,
+        std::string const &channelName,
+        int propertyMask,
+        unsigned dbeMask,
+        CaType caType,
+        int queueSize,
+        epics::pvData::PVStructurePtr const &pvStructure);
+    virtual ~MonitorShare();
+    /* After detach the client gets no more events */
+    void detach(DbPvMonitor *client);
+    void start(DbPvMonitor *client);
+    void stop(DbPvMonitor *client);
+    virtual std::string getRequesterName();
+    virtual void message(
+        std::string const &message,
+        epics::pvData::MessageType messageType);
+    virtual void exceptionCallback(long status,long op);
+    virtual void connectionCallback();
+    virtual void accessRightsCallback();
+    virtual void eventCallback(const char *status);
+private:
+    shared_pointer getPtrSelf()
+    {
+        return shared_from_this();
+    }
+    MonitorShare(
+        std::string const &channelName,
+        int propertyMask,
+        unsigned dbeMask,
+        CaType caType,
+        epics::pvData::PVStructurePtr const &pvStructure);
+    bool connect();
+    void addClient(
+        std::tr1::shared_ptr<DbPvMonitor> const &client,
+        int queueSize);
+
+    struct Client {
+        std::tr1::shared_ptr<DbPvMonitor> monitor;
+        int queueSize;
+        bool isStarted;
+    };
+    DbUtilPtr dbUtil;
+    std::string channelName;
+    int propertyMask;
+    unsigned dbeMask;
+    CaType caType;
+    dbChannel *dbChan;
+    std::tr1::shared_ptr<DbEventMonitor> dbEventMonitor;
+    epics::pvData::PVStructurePtr pvStructure;
+    DbAccessPlanPtr accessPlan;
+    DbRecordData recordData;
+    epics::pvData::BitSet::shared_pointer changedBitSet;
+    ArraySnapshotPool arrayPool;
+    // the initial update of a client started after others
+    epics::pvData::PVStructurePtr startStructure;
+    DbAccessPlanPtr startPlan;
+    DbRecordData startData;
+    epics::pvData::BitSet::shared_pointer startBitSet;
+    epics::pvData::Mutex mutex;
+    std::vector<Client> clients;
+    size_t numberStarted;
+    size_t numberElements;
+};
+
+}}
+
+#endif  /* MONITORSHARE_H */
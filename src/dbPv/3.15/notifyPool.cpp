@@ -0,0 +1,189 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The processNotify pool of blocking get and put requests.
+ */
+
+#include <cstddef>
+
+#include <callback.h>
+#include <dbNotify.h>
+
+#define epicsExportSharedSymbols
+
+#include <epicsExport.h>
+#include "notifyPool.h"
+#include "dbPvTrace.h"
+
+using namespace epics::pvData;
+
+// Number of blocking requests of one get or put that may wait
+// for the record at the same time. pvAccess has at most one request
+// of an operation pending, so more only help in-process callers.
+extern "C" {
+    int dbPvNotifyPoolSize = 1;
+    epicsExportAddress(int, dbPvNotifyPoolSize);
+}
+
+namespace epics { namespace pvaSrv {
+
+NotifyPool::Request::Request()
+: notify(),
+  owner(0),
+  used(false)
+{
+}
+
+NotifyPool::NotifyPool()
+: size(1),
+  prototype(),
+  requestOwner(0),
+  dispatchScheduled(false),
+  canceled(false)
+{
+    callbackSetCallback(dispatchCallback, &callback);
+    callbackSetPriority(priorityMedium, &callback);
+    callbackSetUser(this, &callback);
+}
+
+NotifyPool::~NotifyPool()
+{
+    for(size_t i=0; i<requests.size(); i++) delete requests[i];
+}
+
+void NotifyPool::init(
+    dbChannel *chan,
+    notifyRequestType requestType,
+    int (*putCallback)(processNotify *, notifyPutType),
+    void (*getCallback)(processNotify *, notifyGetType),
+    void (*doneCallback)(processNotify *),
+    void *owner)
+{
+    // the notifies are created when the requests need them
+    size = dbPvNotifyPoolSize>1 ? dbPvNotifyPoolSize : 1;
+    prototype.chan = chan;
+    prototype.requestType = requestType;
+    prototype.putCallback = putCallback;
+    prototype.getCallback = getCallback;
+    prototype.doneCallback = doneCallback;
+    requestOwner = owner;
+}
+
+NotifyPool::Request * NotifyPool::createRequest()
+{
+    Request *request = new Request();
+    processNotify *pn = &request->notify;
+    pn->chan = prototype.chan;
+    pn->requestType = prototype.requestType;
+    pn->putCallback = prototype.putCallback;
+    pn->getCallback = prototype.getCallback;
+    pn->doneCallback = prototype.doneCallback;
+    pn->usrPvt = request;
+    request->owner = requestOwner;
+    requests.push_back(request);
+    return request;
+}
+
+void NotifyPool::request(
+    PVStructurePtr const &pvStructure,
+    BitSetPtr const &bitSet)
+{
+    Request *request = 0;
+    {
+        Lock xx(mutex);
+        if(canceled) return;
+        // a free notify is not taken ahead of queued requests
+        if(freeRequests.empty() && pending.empty() && requests.size()<size) {
+            freeRequests.push_back(createRequest());
+        }
+        if(freeRequests.empty() || !pending.empty()) {
+            // the client may reuse pvStructure before the request starts
+            PVStructurePtr value;
+            BitSetPtr changed;
+            if(pvStructure) {
+                value = getPVDataCreate()->createPVStructure(pvStructure);
+            }
+            if(bitSet) {
+                changed.reset(new BitSet());
+                *changed = *bitSet;
+            }
+            pending.push_back(Pending(value, changed));
+            DbPvStats::increment(DbPvStats::notifyPendingCounter);
+            DBPV_TRACE_VALUE(processTrace, 2,
+                "notifyPool::request pending", pending.size());
+            return;
+        }
+        request = freeRequests.back();
+        freeRequests.pop_back();
+    }
+    start(request, pvStructure, bitSet);
+}
+
+void NotifyPool::start(
+    Request *request,
+    PVStructurePtr const &pvStructure,
+    BitSetPtr const &bitSet)
+{
+    // waits until dbNotify is done with a notify used before
+    if(request->used) dbNotifyCancel(&request->notify);
+    request->used = true;
+    request->pvStructure = pvStructure;
+    request->bitSet = bitSet;
+    request->timer.start();
+    dbProcessNotify(&request->notify);
+}
+
+void NotifyPool::release(
+    Request *request,
+    std::tr1::shared_ptr<void> const &owner)
+{
+    Lock xx(mutex);
+    freeRequests.push_back(request);
+    if(canceled || pending.empty() || dispatchScheduled) return;
+    dispatchScheduled = true;
+    keepAlive = owner;
+    callbackRequest(&callback);
+}
+
+void NotifyPool::dispatchCallback(CALLBACK *callback)
+{
+    void *user;
+    callbackGetUser(user, callback);
+    static_cast<NotifyPool *>(user)->dispatch();
+}
+
+void NotifyPool::dispatch()
+{
+    std::tr1::shared_ptr<void> owner;
+    {
+        Lock xx(mutex);
+        while(!canceled && !pending.empty() && !freeRequests.empty()) {
+            Request *request = freeRequests.back();
+            freeRequests.pop_back();
+            Pending next(pending.front());
+            pending.pop_front();
+            xx.unlock();
+            DBPV_TRACE(processTrace, 2, "notifyPool::dispatch start");
+            start(request, next.pvStructure, next.bitSet);
+            xx.lock();
+        }
+        dispatchScheduled = false;
+        owner.swap(keepAlive);
+    }
+    // owner may hold the last reference to this pool
+}
+
+void NotifyPool::cancel()
+{
+    {
+        Lock xx(mutex);
+        canceled = true;
+        pending.clear();
+    }
+    for(size_t i=0; i<requests.size(); i++) {
+        if(requests[i]->used) dbNotifyCancel(&requests[i]->notify);
+    }
+}
+
+}}
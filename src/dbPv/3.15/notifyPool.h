@@ -0,0 +1,114 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* A pool of processNotify for the blocking requests of a DbPvGet
+ * or a DbPvPut.
+ *
+ * The pvAccess server has at most one request of an operation pending,
+ * so one processNotify, the default of dbPvNotifyPoolSize, is enough for
+ * it. An in-process caller may issue a request before the previous one
+ * is done; such requests are queued and started in order as notifies
+ * become free. With dbPvNotifyPoolSize above 1 up to that many requests
+ * of one operation wait for the record at the same time. Notifies are
+ * created when a request needs one.
+ * A queued request holds a copy of the put data; a started request
+ * refers to the caller's, which pvAccess does not reuse before the
+ * request is done. Every request has its own record data and status.
+ *
+ * dbNotify still uses a processNotify after its doneCallback returned,
+ * so a notify is never restarted from its own doneCallback:
+ * release() returns it to the pool and, if requests are queued,
+ * starts them from a callback task. A notify is reused only after
+ * dbNotifyCancel, which waits until dbNotify is done with it and
+ * returns at once if it is idle.
+ */
+
+#ifndef NOTIFYPOOL_H
+#define NOTIFYPOOL_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <callback.h>
+#include <dbChannel.h>
+#include <dbNotify.h>
+
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+
+#include "dbRecordData.h"
+#include "dbPvStats.h"
+
+namespace epics { namespace pvaSrv {
+
+class NotifyPool {
+public:
+    struct Request {
+        Request();
+        processNotify notify;   // notify.usrPvt is the Request
+        void *owner;            // the DbPvGet or DbPvPut
+        epics::pvData::PVStructurePtr pvStructure;  // what to put
+        epics::pvData::BitSetPtr bitSet;
+        DbRecordData recordData;                    // what was got
+        epics::pvData::Status status;
+        DbPvTimer timer;
+        bool used;              // dbProcessNotify was called
+    };
+    NotifyPool();
+    ~NotifyPool();
+    void init(
+        dbChannel *chan,
+        notifyRequestType requestType,
+        int (*putCallback)(processNotify *, notifyPutType),
+        void (*getCallback)(processNotify *, notifyGetType),
+        void (*doneCallback)(processNotify *),
+        void *owner);
+    static Request * getRequest(processNotify *pn)
+    {
+        return static_cast<Request *>(pn->usrPvt);
+    }
+    /* Starts a request now, or queues it until a notify is free */
+    void request(
+        epics::pvData::PVStructurePtr const &pvStructure,
+        epics::pvData::BitSetPtr const &bitSet);
+    /* Called at the end of doneCallback. owner is kept alive until
+     * the queued requests are started.
+     */
+    void release(Request *request, std::tr1::shared_ptr<void> const &owner);
+    /* Drops the queued requests and cancels the active ones */
+    void cancel();
+private:
+    Request * createRequest();
+    struct Pending {
+        Pending(
+            epics::pvData::PVStructurePtr const &pvStructure,
+            epics::pvData::BitSetPtr const &bitSet)
+        : pvStructure(pvStructure), bitSet(bitSet) {}
+        epics::pvData::PVStructurePtr pvStructure;
+        epics::pvData::BitSetPtr bitSet;
+    };
+    static void dispatchCallback(CALLBACK *callback);
+    void dispatch();
+    void start(
+        Request *request,
+        epics::pvData::PVStructurePtr const &pvStructure,
+        epics::pvData::BitSetPtr const &bitSet);
+    size_t size;                // most notifies of the pool
+    processNotify prototype;    // what init set for every notify
+    void *requestOwner;
+    std::vector<Request *> requests;
+    std::vector<Request *> freeRequests;
+    std::deque<Pending> pending;
+    CALLBACK callback;
+    bool dispatchScheduled;
+    std::tr1::shared_ptr<void> keepAlive;
+    bool canceled;
+    epics::pvData::Mutex mutex;
+};
+
+}}
+
+#endif  /* NOTIFYPOOL_H */
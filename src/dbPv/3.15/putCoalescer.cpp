@@ -0,0 +1,148 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The latest value slot of coalescing puts.
+ */
+
+#include <callback.h>
+#include <dbAccess.h>
+#include <dbNotify.h>
+
+#define epicsExportSharedSymbols
+
+#include "putCoalescer.h"
+#include "dbPvTrace.h"
+#include "dbPvStats.h"
+
+using namespace epics::pvData;
+
+namespace epics { namespace pvaSrv {
+
+static const Status supersededStatus(Status::STATUSTYPE_WARNING, "superseded");
+
+PutCoalescer::PutCoalescer(dbChannel *dbChan)
+: notify(),
+  slotProcess(false),
+  active(false)
+{
+    notify.chan = dbChan;
+    notify.requestType = putProcessRequest;
+    notify.putCallback = putCallback;
+    notify.doneCallback = doneCallback;
+    notify.usrPvt = this;
+    callbackSetCallback(runCallback, &callback);
+    callbackSetPriority(priorityMedium, &callback);
+    callbackSetUser(this, &callback);
+}
+
+PutCoalescer::~PutCoalescer()
+{
+    dbNotifyCancel(&notify);
+}
+
+void PutCoalescer::put(
+    PutCoalescerRequester::shared_pointer const &requester,
+    PVStructurePtr const &pvStructure,
+    bool process)
+{
+    PutCoalescerRequester::shared_pointer superseded;
+    bool start = false;
+    {
+        Lock xx(mutex);
+        superseded.swap(slotRequester);
+        slotRequester = requester;
+        slotValue = pvStructure;
+        slotProcess = process;
+        if(!active) {
+            active = true;
+            start = true;
+        }
+    }
+    if(superseded) {
+        DBPV_TRACE(putTrace, 2, "putCoalescer::put superseded");
+        DbPvStats::increment(DbPvStats::putSupersededCounter);
+        superseded->coalescedPutDone(supersededStatus);
+    }
+    if(start) callbackRequest(&callback);
+}
+
+void PutCoalescer::runCallback(CALLBACK *callback)
+{
+    void *user;
+    callbackGetUser(user, callback);
+    static_cast<PutCoalescer *>(user)->run();
+}
+
+/* Completes the put that was applied and applies the slot.
+ * Runs once per applied put, in a callback task, so that the notify is
+ * never restarted from its own doneCallback.
+ */
+void PutCoalescer::run()
+{
+    // waits until dbNotify is done with the notify, if it was used
+    dbNotifyCancel(&notify);
+    PutCoalescerRequester::shared_pointer done;
+    Status doneStatus;
+    PutCoalescerRequester::shared_pointer next;
+    PVStructurePtr value;
+    bool process = false;
+    {
+        Lock xx(mutex);
+        done.swap(activeRequester);
+        doneStatus = activeStatus;
+        activeValue.reset();
+        if(slotRequester) {
+            next.swap(slotRequester);
+            value.swap(slotValue);
+            process = slotProcess;
+            activeRequester = next;
+            activeValue = value;
+            activeStatus = Status::Ok;
+        } else {
+            active = false;
+        }
+    }
+    if(done) done->coalescedPutDone(doneStatus);
+    // done may have held the last reference to this coalescer
+    if(!next) return;
+    if(process) {
+        DBPV_TRACE(putTrace, 2, "putCoalescer::run dbProcessNotify");
+        dbProcessNotify(&notify);
+        return;
+    }
+    Status status = next->coalescedPut(value);
+    {
+        Lock xx(mutex);
+        activeStatus = status;
+    }
+    callbackRequest(&callback);
+}
+
+int PutCoalescer::putCallback(processNotify *pn, notifyPutType type)
+{
+    PutCoalescer *coalescer = static_cast<PutCoalescer *>(pn->usrPvt);
+
+    if (pn->status == notifyCanceled) return 0;
+    if (type == putDisabledType) {
+        coalescer->activeStatus = Status(Status::STATUSTYPE_ERROR, "put disabled");
+        pn->status = notifyError;
+        return 0;
+    }
+    coalescer->activeStatus = coalescer->activeRequester->coalescedPutNotify(
+        coalescer->activeValue, type);
+    if (!coalescer->activeStatus.isSuccess()) {
+        // e.g. write access was revoked while the put was in the slot
+        pn->status = notifyError;
+        return 0;
+    }
+    return 1;
+}
+
+void PutCoalescer::doneCallback(processNotify *pn)
+{
+    PutCoalescer *coalescer = static_cast<PutCoalescer *>(pn->usrPvt);
+    callbackRequest(&coalescer->callback);
+}
+
+}}
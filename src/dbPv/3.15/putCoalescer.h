@@ -0,0 +1,81 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* The latest value slot of a client channel (DbPv) for puts requested
+ * with record._options.coalesce=true.
+ *
+ * put() stores a copy of the value in the slot and returns; a callback
+ * task applies the slot to the record. A put that finds the slot still
+ * holding an earlier value replaces it, the earlier put completes with
+ * a "superseded" warning. A put that processes the record uses a
+ * processNotify, so that the next value is only applied after the
+ * record completed processing the previous one; meanwhile all but the
+ * newest value are superseded.
+ *
+ * The slot and the put being applied hold their requester, which in
+ * turn holds the channel and this coalescer.
+ */
+
+#ifndef PUTCOALESCER_H
+#define PUTCOALESCER_H
+
+#include <callback.h>
+#include <dbChannel.h>
+#include <dbNotify.h>
+
+#include <pv/lock.h>
+#include <pv/pvData.h>
+
+namespace epics { namespace pvaSrv {
+
+class PutCoalescerRequester {
+public:
+    POINTER_DEFINITIONS(PutCoalescerRequester);
+    virtual ~PutCoalescerRequester() {}
+    /* Puts pvStructure and processes the record if requested */
+    virtual epics::pvData::Status coalescedPut(
+        epics::pvData::PVStructurePtr const &pvStructure) = 0;
+    /* Puts pvStructure from processNotify's putCallback,
+     * with the record locked
+     */
+    virtual epics::pvData::Status coalescedPutNotify(
+        epics::pvData::PVStructurePtr const &pvStructure,
+        notifyPutType type) = 0;
+    virtual void coalescedPutDone(epics::pvData::Status const &status) = 0;
+};
+
+class PutCoalescer {
+public:
+    POINTER_DEFINITIONS(PutCoalescer);
+    explicit PutCoalescer(dbChannel *dbChan);
+    ~PutCoalescer();
+    /* pvStructure must not be changed after the call.
+     * With process the record is put and processed by a processNotify.
+     */
+    void put(
+        PutCoalescerRequester::shared_pointer const &requester,
+        epics::pvData::PVStructurePtr const &pvStructure,
+        bool process);
+private:
+    static void runCallback(CALLBACK *callback);
+    static int putCallback(processNotify *pn, notifyPutType type);
+    static void doneCallback(processNotify *pn);
+    void run();
+    processNotify notify;
+    CALLBACK callback;
+    // the newest put, not yet applied
+    PutCoalescerRequester::shared_pointer slotRequester;
+    epics::pvData::PVStructurePtr slotValue;
+    bool slotProcess;
+    // the put being applied
+    PutCoalescerRequester::shared_pointer activeRequester;
+    epics::pvData::PVStructurePtr activeValue;
+    epics::pvData::Status activeStatus;
+    bool active;     // the callback is queued or a put is being applied
+    epics::pvData::Mutex mutex;
+};
+
+}}
+
+#endif  /* PUTCOALESCER_H */
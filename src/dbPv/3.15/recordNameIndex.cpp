@@ -0,0 +1,154 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* An immutable index of the record names (and aliases) of the IOC,
+ * built once after iocInit, when no more records can be added.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dbAccess.h>
+#include <dbStaticLib.h>
+#include <dbChannel.h>
+
+#define epicsExportSharedSymbols
+
+#include "recordNameIndex.h"
+
+using std::string;
+
+namespace epics { namespace pvaSrv {
+
+// bits of the Bloom filter per record, and bits set per record
+static const size_t bloomBitsPerRecord = 16;
+static const size_t bloomProbes = 6;
+
+// FNV-1a, the second hash uses another offset basis
+static epicsUInt32 hashName(
+    const char *name, size_t length, epicsUInt32 hash)
+{
+    for(size_t i=0; i<length; i++) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const epicsUInt32 hashBasis1 = 2166136261u;
+static const epicsUInt32 hashBasis2 = 0x9747b28cu;
+
+static size_t powerOfTwoAtLeast(size_t n)
+{
+    size_t size = 1;
+    while(size<n) size <<= 1;
+    return size;
+}
+
+RecordNameIndex::RecordNameIndex()
+: tableMask(0),
+  bloomMask(0),
+  numberRecords(0)
+{
+    std::vector<string> recordNames;
+    std::vector<bool> hasValues;
+    if(pdbbase) {
+        DBENTRY dbentry;
+        DBENTRY *pdbentry=&dbentry;
+        dbInitEntry(pdbbase, pdbentry);
+        long status = dbFirstRecordType(pdbentry);
+        while (!status) {
+            status = dbFirstRecord(pdbentry);
+            while (!status) {
+                recordNames.push_back(dbGetRecordName(pdbentry));
+                hasValues.push_back(dbFindField(pdbentry, "VAL")==0);
+                status = dbNextRecord(pdbentry);
+            }
+            status = dbNextRecordType(pdbentry);
+        }
+        dbFinishEntry(pdbentry);
+    }
+    size_t tableSize = powerOfTwoAtLeast(2*recordNames.size()+1);
+    table.resize(tableSize);
+    for(size_t i=0; i<tableSize; i++) table[i].nameLength = 0;
+    tableMask = tableSize-1;
+    size_t bloomBits = powerOfTwoAtLeast(
+        bloomBitsPerRecord*recordNames.size()+64);
+    bloom.resize(bloomBits/32, 0);
+    bloomMask = bloomBits-1;
+    for(size_t i=0; i<recordNames.size(); i++) {
+        add(recordNames[i].c_str(), hasValues[i]);
+    }
+}
+
+void RecordNameIndex::add(const char *name, bool hasValue)
+{
+    size_t length = strlen(name);
+    if(length==0 || find(name, length)) return;
+    epicsUInt32 hash1 = hashName(name, length, hashBasis1);
+    epicsUInt32 hash2 = hashName(name, length, hashBasis2) | 1;
+    for(size_t i=0; i<bloomProbes; i++) {
+        size_t bit = (hash1 + i*hash2)&bloomMask;
+        bloom[bit/32] |= 1u<<(bit%32);
+    }
+    size_t index = hash1&tableMask;
+    while(table[index].nameLength!=0) index = (index+1)&tableMask;
+    Entry &entry = table[index];
+    entry.hash = hash1;
+    entry.nameOffset = names.size();
+    entry.nameLength = length;
+    entry.hasValue = hasValue;
+    names.insert(names.end(), name, name+length);
+    numberRecords++;
+}
+
+bool RecordNameIndex::mayContain(epicsUInt32 hash1, epicsUInt32 hash2) const
+{
+    for(size_t i=0; i<bloomProbes; i++) {
+        size_t bit = (hash1 + i*hash2)&bloomMask;
+        if(!(bloom[bit/32]&(1u<<(bit%32)))) return false;
+    }
+    return true;
+}
+
+const RecordNameIndex::Entry * RecordNameIndex::find(
+    const char *name, size_t length) const
+{
+    epicsUInt32 hash1 = hashName(name, length, hashBasis1);
+    epicsUInt32 hash2 = hashName(name, length, hashBasis2) | 1;
+    if(!mayContain(hash1, hash2)) return 0;
+    size_t index = hash1&tableMask;
+    while(true) {
+        const Entry &entry = table[index];
+        if(entry.nameLength==0) return 0;
+        if(entry.hash==hash1 && entry.nameLength==length
+        && memcmp(&names[entry.nameOffset], name, length)==0) {
+            return &entry;
+        }
+        index = (index+1)&tableMask;
+    }
+}
+
+bool RecordNameIndex::hasRecordOf(string const &channelName) const
+{
+    size_t length = channelName.find('.');
+    if(length==string::npos) length = channelName.size();
+    return find(channelName.data(), length)!=0;
+}
+
+long RecordNameIndex::channelTest(string const &channelName) const
+{
+    // the record name ends at the first '.'
+    size_t length = channelName.find('.');
+    bool hasField = length!=string::npos;
+    if(!hasField) length = channelName.size();
+    const Entry *entry = find(channelName.data(), length);
+    if(!entry) return S_db_notFound;
+    if(hasField) return dbChannelTest(channelName.c_str());
+    return entry->hasValue ? 0 : S_db_notFound;
+}
+
+}}
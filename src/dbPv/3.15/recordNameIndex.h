@@ -0,0 +1,61 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* An immutable index of the record names (and aliases) of the IOC,
+ * built once after iocInit, when no more records can be added.
+ *
+ * A Bloom filter answers most searches for names of other IOCs without
+ * touching the table. The table is open addressing with linear probing,
+ * filled to at most one half. Neither takes a lock or calls dbStaticLib.
+ */
+
+#ifndef RECORDNAMEINDEX_H
+#define RECORDNAMEINDEX_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <epicsTypes.h>
+
+#include <pv/noDefaultMethods.h>
+
+namespace epics { namespace pvaSrv {
+
+class RecordNameIndex : private epics::pvData::NoDefaultMethods {
+public:
+    /* Indexes all records of pdbbase */
+    RecordNameIndex();
+    ~RecordNameIndex() {}
+    /* Same result as dbChannelTest. Only names with a field part
+     * of an existing record are passed on to dbChannelTest.
+     */
+    long channelTest(std::string const &channelName) const;
+    /* Is the record part of channelName (up to the first '.')
+     * the name or alias of a record
+     */
+    bool hasRecordOf(std::string const &channelName) const;
+    size_t getNumberRecords() const { return numberRecords; }
+private:
+    struct Entry {
+        epicsUInt32 hash;
+        epicsUInt32 nameOffset;
+        epicsUInt16 nameLength;  // 0 for a free entry
+        bool hasValue;           // record has a VAL field
+    };
+    void add(const char *name, bool hasValue);
+    const Entry * find(const char *name, size_t length) const;
+    bool mayContain(epicsUInt32 hash1, epicsUInt32 hash2) const;
+
+    std::vector<char> names;
+    std::vector<Entry> table;
+    size_t tableMask;
+    std::vector<epicsUInt32> bloom;
+    size_t bloomMask;   // in bits
+    size_t numberRecords;
+};
+
+}}
+
+#endif  /* RECORDNAMEINDEX_H */
@@ -0,0 +1,525 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Benchmarks of the dbPv provider in an IOC of its own, without network.
+ * It loads records of every scalar type, enum, string and arrays of
+ * 1 to 1000000 elements, then times ChannelGet, ChannelPut and
+ * ChannelArray getArray/putArray (with several offsets and strides).
+ * Only the pvAccess interfaces are used, so the results of the
+ * 3.14 and 3.15 code paths can be compared.
+ *
+ * The results are written to stdout as CSV (default) or JSON,
+ * one row per measurement, progress goes to stderr.
+ *
+ * usage: benchDbPv [-c count] [-f csv|json] [-t top]
+ * count is the number of iterations for a scalar (default 100000),
+ * arrays do fewer; top is testTop (default .), which has dbd and db.
+ * for example, from testTop:
+ *     bin/$EPICS_HOST_ARCH/benchDbPv -f json > bench.json
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dbAccess.h>
+#include <dbStaticLib.h>
+#include <iocInit.h>
+#include <epicsExit.h>
+#include <epicsTime.h>
+#include <epicsVersion.h>
+
+#include <pv/pvData.h>
+#include <pv/event.h>
+#include <pv/pvAccess.h>
+#include <pv/createRequest.h>
+
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+using std::string;
+
+extern "C" int benchDbPv_registerRecordDeviceDriver(struct dbBase *pdbbase);
+
+static const size_t arraySizes[] = {1, 100, 10000, 1000000};
+static const size_t numberArraySizes = sizeof(arraySizes)/sizeof(arraySizes[0]);
+
+struct ScalarRecord {
+    const char *name;
+    const char *db;
+    const char *recordType;
+};
+
+static const ScalarRecord scalarRecords[] = {
+    {"byte", "dbInteger.db", "byter"},
+    {"ubyte", "dbInteger.db", "ubyte"},
+    {"short", "dbInteger.db", "shortr"},
+    {"ushort", "dbInteger.db", "ushort"},
+    {"int", "dbInteger.db", "longout"},
+    {"uint", "dbInteger.db", "ulong"},
+    {"float", "dbScalar.db", "floatr"},
+    {"double", "dbScalar.db", "ai"},
+    {"string", "dbString.db", 0},
+    {"enum", "dbEnum.db", 0}
+};
+static const size_t numberScalarRecords =
+    sizeof(scalarRecords)/sizeof(scalarRecords[0]);
+
+struct ArrayType {
+    const char *ftvl;
+    ScalarType scalarType;
+    size_t elementSize;
+};
+
+static const ArrayType arrayTypes[] = {
+    {"CHAR", pvByte, 1},
+    {"UCHAR", pvUByte, 1},
+    {"SHORT", pvShort, 2},
+    {"USHORT", pvUShort, 2},
+    {"LONG", pvInt, 4},
+    {"ULONG", pvUInt, 4},
+    {"FLOAT", pvFloat, 4},
+    {"DOUBLE", pvDouble, 8}
+};
+static const size_t numberArrayTypes = sizeof(arrayTypes)/sizeof(arrayTypes[0]);
+
+struct BenchResult {
+    string operation;
+    string channel;
+    string type;
+    size_t elements;
+    string request;
+    long iterations;
+    double usPerOperation;
+    double bytes;   // per operation, 0 if not an array
+};
+
+class BenchRequester :
+    public virtual Requester,
+    public ChannelRequester,
+    public ChannelGetRequester,
+    public ChannelPutRequester,
+    public ChannelArrayRequester
+{
+public:
+    POINTER_DEFINITIONS(BenchRequester);
+    BenchRequester() : completed(0), failed(0) {}
+    virtual ~BenchRequester() {}
+    virtual string getRequesterName() { return "benchDbPv"; }
+    virtual void message(string const &message,MessageType messageType)
+    {
+        fprintf(stderr, "benchDbPv %s %s\n",
+            getMessageTypeName(messageType).c_str(),
+            message.c_str());
+    }
+    virtual void channelCreated(
+        const Status &status,
+        Channel::shared_pointer const &channel)
+    {
+        done(status);
+    }
+    virtual void channelStateChange(
+        Channel::shared_pointer const & channel,
+        Channel::ConnectionState connectionState)
+    {}
+    virtual void channelGetConnect(
+        const Status &status,
+        ChannelGet::shared_pointer const &channelGet,
+        StructureConstPtr const &structure)
+    {
+        done(status);
+    }
+    virtual void getDone(
+        const Status &status,
+        ChannelGet::shared_pointer const &channelGet,
+        PVStructurePtr const &pvStructure,
+        BitSetPtr const &bitSet)
+    {
+        done(status);
+    }
+    virtual void channelPutConnect(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut,
+        StructureConstPtr const &structure)
+    {
+        putStructure = structure;
+        done(status);
+    }
+    virtual void putDone(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut)
+    {
+        done(status);
+    }
+    virtual void getDone(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut,
+        PVStructurePtr const &pvStructure,
+        BitSetPtr const &bitSet)
+    {
+        done(status);
+    }
+    virtual void channelArrayConnect(
+        const Status &status,
+        ChannelArray::shared_pointer const &channelArray,
+        Array::const_shared_pointer const &array)
+    {
+        done(status);
+    }
+    virtual void putArrayDone(
+        const Status &status,
+        ChannelArray::shared_pointer const &channelArray)
+    {
+        done(status);
+    }
+    virtual void getArrayDone(
+        const Status &status,
+        ChannelArray::shared_pointer const &channelArray,
+        PVArray::shared_pointer const &pvArray)
+    {
+        done(status);
+    }
+    virtual void getLengthDone(
+        const Status &status,
+        ChannelArray::shared_pointer const &channelArray,
+        size_t length)
+    {
+        done(status);
+    }
+    virtual void setLengthDone(
+        const Status &status,
+        ChannelArray::shared_pointer const &channelArray)
+    {
+        done(status);
+    }
+    /* waits until number operations have completed since reset */
+    void wait(long number)
+    {
+        while(completed<number) event.wait();
+    }
+    void reset() { completed = 0; failed = 0; }
+    long getFailed() const { return failed; }
+    StructureConstPtr getPutStructure() const { return putStructure; }
+private:
+    void done(const Status &status)
+    {
+        if(!status.isSuccess()) failed++;
+        completed++;
+        event.signal();
+    }
+    volatile long completed;
+    long failed;
+    Event event;
+    StructureConstPtr putStructure;
+};
+
+typedef std::vector<BenchResult> BenchResults;
+
+static PVStructurePtr createRequest(string const &request)
+{
+    return CreateRequest::create()->createRequest(request);
+}
+
+static void addResult(
+    BenchResults &results,
+    const char *operation,
+    string const &channel,
+    string const &type,
+    size_t elements,
+    string const &request,
+    long iterations,
+    epicsTime const &start,
+    double bytes)
+{
+    epicsTime end = epicsTime::getCurrent();
+    BenchResult result;
+    result.operation = operation;
+    result.channel = channel;
+    result.type = type;
+    result.elements = elements;
+    result.request = request;
+    result.iterations = iterations;
+    result.usPerOperation = (end - start)*1e6/iterations;
+    result.bytes = bytes;
+    results.push_back(result);
+    fprintf(stderr, "%-9s %-24s %-28s %10.3f us\n",
+        operation, channel.c_str(), request.c_str(), result.usPerOperation);
+}
+
+static long iterationsFor(long count, size_t elements)
+{
+    long iterations = count/static_cast<long>(1 + elements/64);
+    return iterations<10 ? 10 : iterations;
+}
+
+static void benchGet(
+    BenchResults &results,
+    Channel::shared_pointer const &channel,
+    BenchRequester::shared_pointer const &requester,
+    string const &type,
+    size_t elements,
+    double elementSize,
+    string const &request,
+    long count)
+{
+    requester->reset();
+    ChannelGet::shared_pointer channelGet =
+        channel->createChannelGet(requester, createRequest(request));
+    requester->wait(1);
+    if(!channelGet || requester->getFailed()) return;
+    long iterations = iterationsFor(count, elements);
+    requester->reset();
+    epicsTime start = epicsTime::getCurrent();
+    for(long i=0; i<iterations; i++) {
+        channelGet->get();
+        requester->wait(i+1);
+    }
+    addResult(results, "get", channel->getChannelName(), type, elements,
+        request, iterations, start, elements*elementSize);
+    channelGet->destroy();
+}
+
+static void benchPut(
+    BenchResults &results,
+    Channel::shared_pointer const &channel,
+    BenchRequester::shared_pointer const &requester,
+    string const &type,
+    size_t elements,
+    double elementSize,
+    long count)
+{
+    string request("record[process=false]field(value)");
+    requester->reset();
+    ChannelPut::shared_pointer channelPut =
+        channel->createChannelPut(requester, createRequest(request));
+    requester->wait(1);
+    if(!channelPut || requester->getFailed()) return;
+    PVStructurePtr pvStructure = getPVDataCreate()->createPVStructure(
+        requester->getPutStructure());
+    PVScalarArrayPtr pvArray = pvStructure->getSubField<PVScalarArray>("value");
+    if(pvArray) pvArray->setLength(elements);
+    BitSetPtr bitSet(new BitSet(pvStructure->getNumberFields()));
+    bitSet->set(pvStructure->getSubField("value")->getFieldOffset());
+    long iterations = iterationsFor(count, elements);
+    requester->reset();
+    epicsTime start = epicsTime::getCurrent();
+    for(long i=0; i<iterations; i++) {
+        channelPut->put(pvStructure, bitSet);
+        requester->wait(i+1);
+    }
+    addResult(results, "put", channel->getChannelName(), type, elements,
+        request, iterations, start, elements*elementSize);
+    channelPut->destroy();
+}
+
+static void benchArray(
+    BenchResults &results,
+    Channel::shared_pointer const &channel,
+    BenchRequester::shared_pointer const &requester,
+    ArrayType const &arrayType,
+    size_t elements,
+    long count)
+{
+    requester->reset();
+    ChannelArray::shared_pointer channelArray = channel->createChannelArray(
+        requester, createRequest("field(value)"));
+    requester->wait(1);
+    if(!channelArray || requester->getFailed()) return;
+    PVScalarArrayPtr pvPut =
+        getPVDataCreate()->createPVScalarArray(arrayType.scalarType);
+    // offset, count and stride: all, the middle half, every second one
+    struct Access { size_t offset; size_t count; size_t stride; };
+    Access accesses[3] = {
+        {0, elements, 1},
+        {elements/4, elements/2, 1},
+        {0, elements/2, 2}
+    };
+    size_t numberAccesses = elements<4 ? 1 : 3;
+    long iterations = iterationsFor(count, elements);
+    for(size_t a=0; a<numberAccesses; a++) {
+        Access const &access = accesses[a];
+        char buffer[80];
+        sprintf(buffer, "offset=%lu count=%lu stride=%lu",
+            (unsigned long)access.offset,
+            (unsigned long)access.count,
+            (unsigned long)access.stride);
+        string request(buffer);
+        double bytes = access.count*arrayType.elementSize;
+        requester->reset();
+        epicsTime start = epicsTime::getCurrent();
+        for(long i=0; i<iterations; i++) {
+            channelArray->getArray(access.offset, access.count, access.stride);
+            requester->wait(i+1);
+        }
+        addResult(results, "getArray", channel->getChannelName(),
+            arrayType.ftvl, elements, request, iterations, start, bytes);
+        pvPut->setLength(access.count);
+        requester->reset();
+        start = epicsTime::getCurrent();
+        for(long i=0; i<iterations; i++) {
+            channelArray->putArray(
+                pvPut, access.offset, access.count, access.stride);
+            requester->wait(i+1);
+        }
+        addResult(results, "putArray", channel->getChannelName(),
+            arrayType.ftvl, elements, request, iterations, start, bytes);
+    }
+    channelArray->destroy();
+}
+
+static Channel::shared_pointer createChannel(
+    ChannelProvider::shared_pointer const &provider,
+    BenchRequester::shared_pointer const &requester,
+    string const &name)
+{
+    requester->reset();
+    Channel::shared_pointer channel =
+        provider->createChannel(name, requester, 0, "");
+    requester->wait(1);
+    if(requester->getFailed()) return Channel::shared_pointer();
+    return channel;
+}
+
+static void writeCsv(BenchResults const &results)
+{
+    printf("base,operation,channel,type,elements,request,"
+        "iterations,usPerOperation,MBPerSecond\n");
+    for(size_t i=0; i<results.size(); i++) {
+        BenchResult const &result = results[i];
+        double rate = result.usPerOperation>0 ?
+            result.bytes/result.usPerOperation : 0.0;
+        printf("%s,%s,%s,%s,%lu,\"%s\",%ld,%.4f,%.2f\n",
+            EPICS_VERSION_STRING,
+            result.operation.c_str(),
+            result.channel.c_str(),
+            result.type.c_str(),
+            (unsigned long)result.elements,
+            result.request.c_str(),
+            result.iterations,
+            result.usPerOperation,
+            rate);
+    }
+}
+
+static void writeJson(BenchResults const &results)
+{
+    printf("{\n  \"base\": \"%s\",\n  \"results\": [\n", EPICS_VERSION_STRING);
+    for(size_t i=0; i<results.size(); i++) {
+        BenchResult const &result = results[i];
+        double rate = result.usPerOperation>0 ?
+            result.bytes/result.usPerOperation : 0.0;
+        printf("    {\"operation\": \"%s\", \"channel\": \"%s\", "
+            "\"type\": \"%s\", \"elements\": %lu, \"request\": \"%s\", "
+            "\"iterations\": %ld, \"usPerOperation\": %.4f, "
+            "\"MBPerSecond\": %.2f}%s\n",
+            result.operation.c_str(),
+            result.channel.c_str(),
+            result.type.c_str(),
+            (unsigned long)result.elements,
+            result.request.c_str(),
+            result.iterations,
+            result.usPerOperation,
+            rate,
+            i+1<results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+static bool loadDatabase(string const &top)
+{
+    string dbd = top + "/dbd/benchDbPv.dbd";
+    if(dbLoadDatabase(dbd.c_str(), 0, 0)) {
+        fprintf(stderr, "benchDbPv can not load %s\n", dbd.c_str());
+        return false;
+    }
+    benchDbPv_registerRecordDeviceDriver(pdbbase);
+    for(size_t i=0; i<numberScalarRecords; i++) {
+        ScalarRecord const &record = scalarRecords[i];
+        string db = top + "/db/" + record.db;
+        string macros = string("name=bench:") + record.name;
+        if(record.recordType) macros += string(",type=") + record.recordType;
+        if(dbLoadRecords(db.c_str(), macros.c_str())) return false;
+    }
+    string db = top + "/db/benchArray.db";
+    for(size_t i=0; i<numberArrayTypes; i++) {
+        for(size_t j=0; j<numberArraySizes; j++) {
+            char macros[80];
+            sprintf(macros, "name=bench:%s:%lu,type=%s,nelm=%lu",
+                arrayTypes[i].ftvl,
+                (unsigned long)arraySizes[j],
+                arrayTypes[i].ftvl,
+                (unsigned long)arraySizes[j]);
+            if(dbLoadRecords(db.c_str(), macros)) return false;
+        }
+    }
+    return iocInit()==0;
+}
+
+int main(int argc,char *argv[])
+{
+    long count = 100000;
+    bool json = false;
+    string top(".");
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i], "-c")==0 && i+1<argc) {
+            count = atol(argv[++i]);
+        } else if(strcmp(argv[i], "-f")==0 && i+1<argc) {
+            json = strcmp(argv[++i], "json")==0;
+        } else if(strcmp(argv[i], "-t")==0 && i+1<argc) {
+            top = argv[++i];
+        } else {
+            fprintf(stderr,
+                "usage: benchDbPv [-c count] [-f csv|json] [-t top]\n");
+            return 1;
+        }
+    }
+    if(count<=0) count = 100000;
+    if(!loadDatabase(top)) return 1;
+    ChannelProvider::shared_pointer provider =
+        ChannelProviderRegistry::servers()->getProvider("dbPv");
+    if(!provider) {
+        fprintf(stderr, "benchDbPv no dbPv provider\n");
+        return 1;
+    }
+    BenchRequester::shared_pointer requester(new BenchRequester());
+    BenchResults results;
+    for(size_t i=0; i<numberScalarRecords; i++) {
+        ScalarRecord const &record = scalarRecords[i];
+        string name = string("bench:") + record.name;
+        Channel::shared_pointer channel =
+            createChannel(provider, requester, name);
+        if(!channel) continue;
+        benchGet(results, channel, requester, record.name, 1, 0,
+            "field(value)", count);
+        benchGet(results, channel, requester, record.name, 1, 0,
+            "field(value,alarm,timeStamp)", count);
+        benchPut(results, channel, requester, record.name, 1, 0, count);
+        channel->destroy();
+    }
+    for(size_t i=0; i<numberArrayTypes; i++) {
+        ArrayType const &arrayType = arrayTypes[i];
+        for(size_t j=0; j<numberArraySizes; j++) {
+            size_t elements = arraySizes[j];
+            char name[40];
+            sprintf(name, "bench:%s:%lu",
+                arrayType.ftvl, (unsigned long)elements);
+            Channel::shared_pointer channel =
+                createChannel(provider, requester, name);
+            if(!channel) continue;
+            benchGet(results, channel, requester, arrayType.ftvl, elements,
+                arrayType.elementSize, "field(value)", count);
+            benchPut(results, channel, requester, arrayType.ftvl, elements,
+                arrayType.elementSize, count);
+            benchArray(results, channel, requester, arrayType,
+                elements, count);
+            channel->destroy();
+        }
+    }
+    if(json) writeJson(results);
+    else writeCsv(results);
+    epicsExit(0);
+    return 0;
+}
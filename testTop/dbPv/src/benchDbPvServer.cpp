@@ -0,0 +1,603 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* End-to-end benchmark of the dbPv provider behind a pvAccess server.
+ * The program is an IOC with its own records and a pvAccess server
+ * bound to loopback, and the pvAccess client of the same process
+ * drives N channels of it.
+ *
+ * For every channel count, array size and monitor queueSize it measures
+ *   get      gets per second, every channel with one get outstanding
+ *   put      puts per second, likewise
+ *   monitor  updates received per second while the records are processed
+ *            as fast as possible (or at -r puts per second per channel),
+ *            and the latency from the timeStamp of the record (set when
+ *            it is processed) to the receipt by the client
+ *
+ * The results are written to stdout as CSV (default) or JSON,
+ * progress goes to stderr.
+ *
+ * usage: benchDbPvServer [-n channels] [-a elements] [-d seconds]
+ *                        [-r rate] [-f csv|json] [-t top]
+ * channels is the largest channel count of the sweep (default 100),
+ * elements the largest array size (default 10000),
+ * seconds the duration of every measurement (default 2);
+ * top is testTop (default .), which has dbd and db.
+ * for example, from testTop:
+ *     bin/$EPICS_HOST_ARCH/benchDbPvServer -n 1000 -f json > server.json
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <dbAccess.h>
+#include <dbStaticLib.h>
+#include <iocInit.h>
+#include <iocsh.h>
+#include <envDefs.h>
+#include <epicsExit.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsVersion.h>
+
+#include <pv/pvData.h>
+#include <pv/lock.h>
+#include <pv/event.h>
+#include <pv/pvAccess.h>
+#include <pv/clientFactory.h>
+#include <pv/createRequest.h>
+
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+using std::string;
+
+extern "C" int benchDbPvServer_registerRecordDeviceDriver(struct dbBase *pdbbase);
+
+enum Operation {getOperation, putOperation, monitorOperation};
+static const char *operationNames[] = {"get", "put", "monitor"};
+
+struct BenchResult {
+    Operation operation;
+    size_t channels;
+    size_t elements;    // 0 for the scalar record
+    int queueSize;      // monitors only
+    double perSecond;
+    size_t latencies;
+    double latencyMean; // microseconds
+    double latencyP50;
+    double latencyP99;
+    double latencyMax;
+};
+
+typedef std::vector<BenchResult> BenchResults;
+
+// What all channels of a measurement share
+struct BenchState {
+    BenchState() : running(false) {}
+    volatile bool running;
+    Mutex mutex;
+    std::vector<double> latencies;  // microseconds
+};
+
+class BenchChannel :
+    public virtual Requester,
+    public ChannelRequester,
+    public ChannelGetRequester,
+    public ChannelPutRequester,
+    public MonitorRequester,
+    public std::tr1::enable_shared_from_this<BenchChannel>
+{
+public:
+    POINTER_DEFINITIONS(BenchChannel);
+    BenchChannel(BenchState &state, size_t elements)
+    : state(state),
+      elements(elements),
+      connected(false),
+      firstUpdate(true),
+      completed(0),
+      failed(0)
+    {}
+    virtual ~BenchChannel() {}
+    virtual string getRequesterName() { return "benchDbPvServer"; }
+    virtual void message(string const &message,MessageType messageType)
+    {
+        fprintf(stderr, "benchDbPvServer %s %s\n",
+            getMessageTypeName(messageType).c_str(),
+            message.c_str());
+    }
+    virtual void channelCreated(
+        const Status &status,
+        Channel::shared_pointer const &channel)
+    {
+        if(!status.isSuccess()) failed++;
+    }
+    virtual void channelStateChange(
+        Channel::shared_pointer const &channel,
+        Channel::ConnectionState connectionState)
+    {
+        connected = connectionState==Channel::CONNECTED;
+        event.signal();
+    }
+    virtual void channelGetConnect(
+        const Status &status,
+        ChannelGet::shared_pointer const &channelGet,
+        StructureConstPtr const &structure)
+    {
+        if(!status.isSuccess()) failed++;
+        event.signal();
+    }
+    virtual void getDone(
+        const Status &status,
+        ChannelGet::shared_pointer const &channelGet,
+        PVStructurePtr const &pvStructure,
+        BitSetPtr const &bitSet)
+    {
+        done(status);
+        if(state.running) channelGet->get();
+        else event.signal();
+    }
+    virtual void channelPutConnect(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut,
+        StructureConstPtr const &structure)
+    {
+        if(status.isSuccess()) {
+            pvPut = getPVDataCreate()->createPVStructure(structure);
+            PVScalarArrayPtr pvArray =
+                pvPut->getSubField<PVScalarArray>("value");
+            if(pvArray) pvArray->setLength(elements);
+            bitSet.reset(new BitSet(pvPut->getNumberFields()));
+            bitSet->set(pvPut->getSubField("value")->getFieldOffset());
+        } else {
+            failed++;
+        }
+        event.signal();
+    }
+    virtual void putDone(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut)
+    {
+        done(status);
+        if(state.running) channelPut->put(pvPut, bitSet);
+        else event.signal();
+    }
+    virtual void getDone(
+        const Status &status,
+        ChannelPut::shared_pointer const &channelPut,
+        PVStructurePtr const &pvStructure,
+        BitSetPtr const &bitSet)
+    {}
+    virtual void monitorConnect(
+        const Status &status,
+        MonitorPtr const &monitor,
+        StructureConstPtr const &structure)
+    {
+        if(!status.isSuccess()) failed++;
+        event.signal();
+    }
+    virtual void monitorEvent(MonitorPtr const &monitor)
+    {
+        std::vector<double> latencies;
+        MonitorElementPtr element;
+        while((element = monitor->poll())) {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+            PVStructurePtr timeStamp =
+                element->pvStructurePtr->getSubField<PVStructure>("timeStamp");
+            // the first update has the value from before the start
+            bool isFirst = firstUpdate;
+            firstUpdate = false;
+            if(timeStamp && state.running && !isFirst) {
+                double seconds = static_cast<double>(
+                    timeStamp->getSubField<PVLong>("secondsPastEpoch")->get()
+                    - POSIX_TIME_AT_EPICS_EPOCH);
+                double nanoseconds =
+                    timeStamp->getSubField<PVInt>("nanoseconds")->get();
+                double latency = (now.secPastEpoch - seconds)*1e6
+                    + (now.nsec - nanoseconds)/1e3;
+                latencies.push_back(latency);
+                completed++;
+            }
+            monitor->release(element);
+        }
+        if(latencies.empty()) return;
+        Lock xx(state.mutex);
+        state.latencies.insert(
+            state.latencies.end(), latencies.begin(), latencies.end());
+    }
+    virtual void unlisten(MonitorPtr const &monitor) {}
+
+    bool connect(ChannelProvider::shared_pointer const &provider,
+        string const &name)
+    {
+        channel = provider->createChannel(
+            name, getPtrSelf(), ChannelProvider::PRIORITY_DEFAULT);
+        if(!channel) return false;
+        return waitFor(connected);
+    }
+    bool createGet()
+    {
+        channelGet = channel->createChannelGet(
+            getPtrSelf(), createRequest("field(value)"));
+        return channelGet && waitConnect();
+    }
+    bool createPut()
+    {
+        channelPut = channel->createChannelPut(
+            getPtrSelf(), createRequest("field(value)"));
+        return channelPut && waitConnect();
+    }
+    bool createMonitor(int queueSize)
+    {
+        char request[80];
+        sprintf(request,
+            "record[queueSize=%d]field(value,timeStamp)", queueSize);
+        monitor = channel->createMonitor(getPtrSelf(), createRequest(request));
+        return monitor && waitConnect();
+    }
+    void start(Operation operation)
+    {
+        completed = 0;
+        firstUpdate = true;
+        switch(operation) {
+        case getOperation: channelGet->get(); break;
+        case putOperation: channelPut->put(pvPut, bitSet); break;
+        case monitorOperation: monitor->start(); break;
+        }
+    }
+    /* waits for the operation in progress after running was cleared */
+    void stop(Operation operation)
+    {
+        if(operation==monitorOperation) {
+            monitor->stop();
+            return;
+        }
+        event.wait(5.0);
+    }
+    void destroy()
+    {
+        if(channelGet) channelGet->destroy();
+        if(channelPut) channelPut->destroy();
+        if(monitor) monitor->destroy();
+        if(channel) channel->destroy();
+        channelGet.reset();
+        channelPut.reset();
+        monitor.reset();
+        channel.reset();
+    }
+    long getCompleted() const { return completed; }
+    long getFailed() const { return failed; }
+private:
+    shared_pointer getPtrSelf()
+    {
+        return shared_from_this();
+    }
+    static PVStructurePtr createRequest(string const &request)
+    {
+        return CreateRequest::create()->createRequest(request);
+    }
+    bool waitFor(volatile bool const &flag)
+    {
+        for(int i=0; i<50 && !flag; i++) event.wait(0.1);
+        return flag;
+    }
+    bool waitConnect()
+    {
+        long before = failed;
+        event.wait(5.0);
+        return failed==before;
+    }
+    void done(const Status &status)
+    {
+        if(status.isSuccess()) completed++;
+        else failed++;
+    }
+    BenchState &state;
+    size_t elements;
+    Channel::shared_pointer channel;
+    ChannelGet::shared_pointer channelGet;
+    ChannelPut::shared_pointer channelPut;
+    MonitorPtr monitor;
+    PVStructurePtr pvPut;
+    BitSetPtr bitSet;
+    volatile bool connected;
+    bool firstUpdate;
+    volatile long completed;
+    volatile long failed;
+    Event event;
+};
+
+typedef std::vector<BenchChannel::shared_pointer> BenchChannels;
+
+static string recordName(size_t index, size_t elements)
+{
+    char name[40];
+    sprintf(name, "benchServer:%lu%s",
+        (unsigned long)index, elements ? ":array" : "");
+    return name;
+}
+
+// Processes the records of the channels until running is cleared
+struct RecordDriver {
+    RecordDriver(BenchState &state, size_t channels, size_t elements,
+        double rate)
+    : state(state),
+      elements(elements),
+      rate(rate),
+      done(epicsEventMustCreate(epicsEventEmpty))
+    {
+        addrs.resize(channels);
+        for(size_t i=0; i<channels; i++) {
+            dbNameToAddr(recordName(i, elements).c_str(), &addrs[i]);
+        }
+        values.resize(elements ? elements : 1);
+    }
+    ~RecordDriver() { epicsEventDestroy(done); }
+    // also gives the arrays the number of elements to get
+    void put(double value)
+    {
+        std::fill(values.begin(), values.end(), value);
+        for(size_t i=0; i<addrs.size(); i++) {
+            dbPutField(&addrs[i], DBR_DOUBLE, &values[0], values.size());
+        }
+    }
+    static void run(void *arg)
+    {
+        RecordDriver *driver = static_cast<RecordDriver *>(arg);
+        double value = 0.0;
+        while(driver->state.running) {
+            // every put changes the value, so that every one is posted
+            value += 1.0;
+            driver->put(value);
+            if(driver->rate>0) epicsThreadSleep(1.0/driver->rate);
+            else epicsThreadSleep(0.0);
+        }
+        epicsEventSignal(driver->done);
+    }
+    BenchState &state;
+    size_t elements;
+    double rate;
+    std::vector<DBADDR> addrs;
+    std::vector<double> values;
+    epicsEventId done;
+};
+
+static double percentile(std::vector<double> const &sorted, double fraction)
+{
+    if(sorted.empty()) return 0.0;
+    size_t index = static_cast<size_t>(fraction*(sorted.size()-1));
+    return sorted[index];
+}
+
+static bool measure(
+    BenchResults &results,
+    ChannelProvider::shared_pointer const &provider,
+    Operation operation,
+    size_t channels,
+    size_t elements,
+    int queueSize,
+    double seconds,
+    double rate)
+{
+    BenchState state;
+    BenchChannels benchChannels;
+    bool ok = true;
+    for(size_t i=0; i<channels && ok; i++) {
+        BenchChannel::shared_pointer channel(
+            new BenchChannel(state, elements));
+        benchChannels.push_back(channel);
+        ok = channel->connect(provider, recordName(i, elements));
+        if(!ok) break;
+        switch(operation) {
+        case getOperation: ok = channel->createGet(); break;
+        case putOperation: ok = channel->createPut(); break;
+        case monitorOperation: ok = channel->createMonitor(queueSize); break;
+        }
+    }
+    if(ok) {
+        RecordDriver driver(state, channels, elements, rate);
+        driver.put(0.0);
+        state.running = true;
+        if(operation==monitorOperation) {
+            epicsThreadCreate("benchDriver", epicsThreadPriorityMedium,
+                epicsThreadGetStackSize(epicsThreadStackMedium),
+                RecordDriver::run, &driver);
+        }
+        epicsTime start = epicsTime::getCurrent();
+        for(size_t i=0; i<benchChannels.size(); i++) {
+            benchChannels[i]->start(operation);
+        }
+        epicsThreadSleep(seconds);
+        state.running = false;
+        epicsTime end = epicsTime::getCurrent();
+        if(operation==monitorOperation) epicsEventMustWait(driver.done);
+        long completed = 0;
+        for(size_t i=0; i<benchChannels.size(); i++) {
+            benchChannels[i]->stop(operation);
+            completed += benchChannels[i]->getCompleted();
+        }
+        BenchResult result;
+        result.operation = operation;
+        result.channels = channels;
+        result.elements = elements;
+        result.queueSize = operation==monitorOperation ? queueSize : 0;
+        result.perSecond = completed/(end - start);
+        std::vector<double> latencies;
+        {
+            Lock xx(state.mutex);
+            latencies.swap(state.latencies);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0.0;
+        for(size_t i=0; i<latencies.size(); i++) sum += latencies[i];
+        result.latencies = latencies.size();
+        result.latencyMean = latencies.empty() ? 0.0 : sum/latencies.size();
+        result.latencyP50 = percentile(latencies, 0.5);
+        result.latencyP99 = percentile(latencies, 0.99);
+        result.latencyMax = latencies.empty() ? 0.0 : latencies.back();
+        results.push_back(result);
+        fprintf(stderr,
+            "%-8s channels %5lu elements %7lu queueSize %3d"
+            " %10.0f/s latency p50 %8.1f p99 %8.1f us\n",
+            operationNames[operation],
+            (unsigned long)channels,
+            (unsigned long)elements,
+            result.queueSize,
+            result.perSecond,
+            result.latencyP50,
+            result.latencyP99);
+    } else {
+        fprintf(stderr, "benchDbPvServer %s with %lu channels failed\n",
+            operationNames[operation], (unsigned long)channels);
+    }
+    for(size_t i=0; i<benchChannels.size(); i++) {
+        benchChannels[i]->destroy();
+    }
+    return ok;
+}
+
+static void writeCsv(BenchResults const &results)
+{
+    printf("base,operation,channels,elements,queueSize,perSecond,"
+        "latencies,latencyMean,latencyP50,latencyP99,latencyMax\n");
+    for(size_t i=0; i<results.size(); i++) {
+        BenchResult const &result = results[i];
+        printf("%s,%s,%lu,%lu,%d,%.1f,%lu,%.1f,%.1f,%.1f,%.1f\n",
+            EPICS_VERSION_STRING,
+            operationNames[result.operation],
+            (unsigned long)result.channels,
+            (unsigned long)result.elements,
+            result.queueSize,
+            result.perSecond,
+            (unsigned long)result.latencies,
+            result.latencyMean,
+            result.latencyP50,
+            result.latencyP99,
+            result.latencyMax);
+    }
+}
+
+static void writeJson(BenchResults const &results)
+{
+    printf("{\n  \"base\": \"%s\",\n  \"results\": [\n", EPICS_VERSION_STRING);
+    for(size_t i=0; i<results.size(); i++) {
+        BenchResult const &result = results[i];
+        printf("    {\"operation\": \"%s\", \"channels\": %lu, "
+            "\"elements\": %lu, \"queueSize\": %d, \"perSecond\": %.1f, "
+            "\"latencies\": %lu, \"latencyMean\": %.1f, "
+            "\"latencyP50\": %.1f, \"latencyP99\": %.1f, "
+            "\"latencyMax\": %.1f}%s\n",
+            operationNames[result.operation],
+            (unsigned long)result.channels,
+            (unsigned long)result.elements,
+            result.queueSize,
+            result.perSecond,
+            (unsigned long)result.latencies,
+            result.latencyMean,
+            result.latencyP50,
+            result.latencyP99,
+            result.latencyMax,
+            i+1<results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+static bool startIoc(string const &top, size_t channels, size_t maxElements)
+{
+    // server and client only talk over loopback
+    epicsEnvSet("EPICS_PVAS_INTF_ADDR_LIST", "127.0.0.1");
+    epicsEnvSet("EPICS_PVA_ADDR_LIST", "127.0.0.1");
+    epicsEnvSet("EPICS_PVA_AUTO_ADDR_LIST", "NO");
+    string dbd = top + "/dbd/benchDbPvServer.dbd";
+    if(dbLoadDatabase(dbd.c_str(), 0, 0)) {
+        fprintf(stderr, "benchDbPvServer can not load %s\n", dbd.c_str());
+        return false;
+    }
+    benchDbPvServer_registerRecordDeviceDriver(pdbbase);
+    string db = top + "/db/benchServer.db";
+    for(size_t i=0; i<channels; i++) {
+        char macros[80];
+        sprintf(macros, "name=benchServer:%lu,nelm=%lu",
+            (unsigned long)i, (unsigned long)maxElements);
+        if(dbLoadRecords(db.c_str(), macros)) return false;
+    }
+    if(iocInit()) return false;
+    return iocshCmd("startPVAServer")==0;
+}
+
+int main(int argc,char *argv[])
+{
+    size_t maxChannels = 100;
+    size_t maxElements = 10000;
+    double seconds = 2.0;
+    double rate = 0.0;
+    bool json = false;
+    string top(".");
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i], "-n")==0 && i+1<argc) {
+            maxChannels = atol(argv[++i]);
+        } else if(strcmp(argv[i], "-a")==0 && i+1<argc) {
+            maxElements = atol(argv[++i]);
+        } else if(strcmp(argv[i], "-d")==0 && i+1<argc) {
+            seconds = atof(argv[++i]);
+        } else if(strcmp(argv[i], "-r")==0 && i+1<argc) {
+            rate = atof(argv[++i]);
+        } else if(strcmp(argv[i], "-f")==0 && i+1<argc) {
+            json = strcmp(argv[++i], "json")==0;
+        } else if(strcmp(argv[i], "-t")==0 && i+1<argc) {
+            top = argv[++i];
+        } else {
+            fprintf(stderr, "usage: benchDbPvServer [-n channels]"
+                " [-a elements] [-d seconds] [-r rate] [-f csv|json]"
+                " [-t top]\n");
+            return 1;
+        }
+    }
+    if(maxChannels<1) maxChannels = 1;
+    if(maxElements<1) maxElements = 1;
+    if(seconds<=0) seconds = 2.0;
+    if(!startIoc(top, maxChannels, maxElements)) return 1;
+    ClientFactory::start();
+    ChannelProvider::shared_pointer provider =
+        ChannelProviderRegistry::clients()->getProvider("pva");
+    if(!provider) {
+        fprintf(stderr, "benchDbPvServer no pva client provider\n");
+        return 1;
+    }
+    // channel counts 1, 10, 100, ... and maxChannels
+    std::vector<size_t> channelCounts;
+    for(size_t n=1; n<maxChannels; n*=10) channelCounts.push_back(n);
+    channelCounts.push_back(maxChannels);
+    // 0 is the scalar record
+    std::vector<size_t> arraySizes;
+    arraySizes.push_back(0);
+    for(size_t n=1; n<maxElements; n*=100) arraySizes.push_back(n);
+    arraySizes.push_back(maxElements);
+    static const int queueSizes[] = {2, 10, 100};
+    BenchResults results;
+    for(size_t c=0; c<channelCounts.size(); c++) {
+        size_t channels = channelCounts[c];
+        for(size_t a=0; a<arraySizes.size(); a++) {
+            size_t elements = arraySizes[a];
+            measure(results, provider, getOperation,
+                channels, elements, 0, seconds, rate);
+            measure(results, provider, putOperation,
+                channels, elements, 0, seconds, rate);
+            for(size_t q=0; q<sizeof(queueSizes)/sizeof(queueSizes[0]); q++) {
+                measure(results, provider, monitorOperation,
+                    channels, elements, queueSizes[q], seconds, rate);
+            }
+        }
+    }
+    if(json) writeJson(results);
+    else writeCsv(results);
+    ClientFactory::stop();
+    epicsExit(0);
+    return 0;
+}
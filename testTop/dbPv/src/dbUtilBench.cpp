@@ -0,0 +1,140 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Measures the cost of DbUtil::get for one channel and pvRequest,
+ * once resolving the fields on every call and once with an access plan
+ * created in advance, which is what DbPvGet and the monitors do.
+ *
+ * usage (iocsh): dbUtilBench pvName [request] [count]
+ * for example: dbUtilBench double01 "field()" 1000000
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+#include <dbAccess.h>
+#include <dbChannel.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+
+#include <pv/pvData.h>
+#include <pv/createRequest.h>
+
+#define epicsExportSharedSymbols
+#include <epicsExport.h>
+#include "dbUtil.h"
+
+using namespace epics::pvData;
+using namespace epics::pvaSrv;
+using std::string;
+
+class BenchRequester : public Requester {
+public:
+    POINTER_DEFINITIONS(BenchRequester);
+    virtual ~BenchRequester() {}
+    virtual string getRequesterName() { return "dbUtilBench"; }
+    virtual void message(string const &message,MessageType messageType)
+    {
+        printf("dbUtilBench %s %s\n",
+            getMessageTypeName(messageType).c_str(),
+            message.c_str());
+    }
+};
+
+// returns the time per get in microseconds
+static double timeGet(
+    DbUtilPtr const &dbUtil,
+    Requester::shared_pointer const &requester,
+    int propertyMask,
+    dbChannel *dbChan,
+    PVStructurePtr const &pvStructure,
+    DbAccessPlan const *plan,
+    long count)
+{
+    BitSet::shared_pointer bitSet(new BitSet(pvStructure->getNumberFields()));
+    dbCommon *precord = dbChannelRecord(dbChan);
+    epicsTime start = epicsTime::getCurrent();
+    for(long i=0; i<count; i++) {
+        bitSet->clear();
+        dbScanLock(precord);
+        if(plan) {
+            dbUtil->get(requester, *plan, bitSet, 0);
+        } else {
+            dbUtil->get(requester, propertyMask, dbChan,
+                pvStructure, bitSet, 0);
+        }
+        dbScanUnlock(precord);
+    }
+    epicsTime end = epicsTime::getCurrent();
+    return (end - start)*1e6/count;
+}
+
+static const iocshArg benchArg0 = { "pvName", iocshArgString };
+static const iocshArg benchArg1 = { "request", iocshArgString };
+static const iocshArg benchArg2 = { "count", iocshArgInt };
+static const iocshArg *benchArgs[] = {
+    &benchArg0, &benchArg1, &benchArg2};
+
+static const iocshFuncDef dbUtilBenchFuncDef = {
+    "dbUtilBench", 3, benchArgs};
+static void dbUtilBenchCallFunc(const iocshArgBuf *args)
+{
+    const char *pvName = args[0].sval;
+    string request(args[1].sval ? args[1].sval : "field()");
+    long count = args[2].ival>0 ? args[2].ival : 1000000;
+    if(!pvName) {
+        printf("usage: dbUtilBench pvName [request] [count]\n");
+        return;
+    }
+    dbChannel *dbChan = dbChannelCreate(pvName);
+    if(!dbChan || dbChannelOpen(dbChan)) {
+        printf("dbUtilBench %s not found\n", pvName);
+        if(dbChan) dbChannelDelete(dbChan);
+        return;
+    }
+    Requester::shared_pointer requester(new BenchRequester());
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest(request));
+    if(!pvRequest) {
+        printf("dbUtilBench bad request %s\n", request.c_str());
+        dbChannelDelete(dbChan);
+        return;
+    }
+    DbUtilPtr dbUtil(DbUtil::getDbUtil());
+    int propertyMask = dbUtil->getProperties(
+        requester, pvRequest, dbChan, false);
+    PVStructurePtr pvStructure;
+    if(propertyMask!=dbUtil->noAccessBit) {
+        pvStructure = dbUtil->createPVStructure(
+            requester, propertyMask, dbChan, pvRequest);
+    }
+    if(!pvStructure) {
+        dbChannelDelete(dbChan);
+        return;
+    }
+    DbAccessPlanPtr plan(dbUtil->createAccessPlan(
+        requester, propertyMask, dbChan, pvStructure));
+    double perCall = timeGet(dbUtil, requester, propertyMask, dbChan,
+        pvStructure, 0, count);
+    double planned = timeGet(dbUtil, requester, propertyMask, dbChan,
+        pvStructure, plan.get(), count);
+    printf("dbUtilBench %s %s count %ld\n", pvName, request.c_str(), count);
+    printf("    resolved per call %.3f us  planned %.3f us  speedup %.2f\n",
+        perCall, planned, planned>0 ? perCall/planned : 0.0);
+    dbChannelDelete(dbChan);
+}
+
+static void dbUtilBenchRegister(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        firstTime = 0;
+        iocshRegister(&dbUtilBenchFuncDef, dbUtilBenchCallFunc);
+    }
+}
+
+extern "C" {
+    epicsExportRegistrar(dbUtilBenchRegister);
+}
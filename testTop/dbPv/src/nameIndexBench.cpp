@@ -0,0 +1,124 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Measures channel searches per second, answered by dbChannelTest and
+ * by the record name index of the dbPv provider, for names of records
+ * of this IOC (hits) and for names that do not exist (misses).
+ *
+ * usage (iocsh): nameIndexBench [count]
+ * for example: nameIndexBench 1000000
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <dbAccess.h>
+#include <dbStaticLib.h>
+#include <dbChannel.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+
+#define epicsExportSharedSymbols
+#include <epicsExport.h>
+#include "recordNameIndex.h"
+
+using namespace epics::pvaSrv;
+using std::string;
+
+// returns searches per second, found is the number of names found
+static double timeSearch(
+    RecordNameIndex const *index,
+    std::vector<string> const &names,
+    long count,
+    long &found)
+{
+    found = 0;
+    size_t n = names.size();
+    epicsTime start = epicsTime::getCurrent();
+    for(long i=0; i<count; i++) {
+        string const &name = names[i%n];
+        long status = index ? index->channelTest(name)
+                            : dbChannelTest(name.c_str());
+        if(status==0) found++;
+    }
+    epicsTime end = epicsTime::getCurrent();
+    double seconds = end - start;
+    return seconds>0 ? count/seconds : 0.0;
+}
+
+static void report(
+    const char *workload,
+    std::vector<string> const &names,
+    RecordNameIndex const &index,
+    long count)
+{
+    long foundTest = 0;
+    long foundIndex = 0;
+    double test = timeSearch(0, names, count, foundTest);
+    double indexed = timeSearch(&index, names, count, foundIndex);
+    printf("    %s dbChannelTest %.0f/s  index %.0f/s  speedup %.2f\n",
+        workload, test, indexed, test>0 ? indexed/test : 0.0);
+    if(foundTest!=foundIndex) {
+        printf("    %s found %ld by dbChannelTest but %ld by index\n",
+            workload, foundTest, foundIndex);
+    }
+}
+
+static const iocshArg benchArg0 = { "count", iocshArgInt };
+static const iocshArg *benchArgs[] = {&benchArg0};
+
+static const iocshFuncDef nameIndexBenchFuncDef = {
+    "nameIndexBench", 1, benchArgs};
+static void nameIndexBenchCallFunc(const iocshArgBuf *args)
+{
+    long count = args[0].ival>0 ? args[0].ival : 1000000;
+    if(!pdbbase) {
+        printf("nameIndexBench no database loaded\n");
+        return;
+    }
+    std::vector<string> hits;
+    DBENTRY dbentry;
+    DBENTRY *pdbentry=&dbentry;
+    dbInitEntry(pdbbase, pdbentry);
+    long status = dbFirstRecordType(pdbentry);
+    while (!status) {
+        status = dbFirstRecord(pdbentry);
+        while (!status) {
+            hits.push_back(dbGetRecordName(pdbentry));
+            status = dbNextRecord(pdbentry);
+        }
+        status = dbNextRecordType(pdbentry);
+    }
+    dbFinishEntry(pdbentry);
+    if(hits.empty()) {
+        printf("nameIndexBench no records\n");
+        return;
+    }
+    std::vector<string> misses;
+    for(size_t i=0; i<hits.size(); i++) {
+        char name[40];
+        sprintf(name, "otherIoc:pv%lu", (unsigned long)i);
+        misses.push_back(name);
+    }
+    RecordNameIndex index;
+    printf("nameIndexBench records %lu count %ld\n",
+        (unsigned long)index.getNumberRecords(), count);
+    report("hit ", hits, index, count);
+    report("miss", misses, index, count);
+}
+
+static void nameIndexBenchRegister(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        firstTime = 0;
+        iocshRegister(&nameIndexBenchFuncDef, nameIndexBenchCallFunc);
+    }
+}
+
+extern "C" {
+    epicsExportRegistrar(nameIndexBenchRegister);
+}
@@ -0,0 +1,235 @@
+/**
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution.
+ */
+/* Stress test for MonitorElementQueue.
+ * A producer thread and the main thread (consumer) run at full rate.
+ * Each element carries a sequence number which the consumer checks,
+ * so any lost or duplicated element is detected.
+ * With an overflow policy the producer does not wait for a free element
+ * but squashes or drops, so the consumer checks that sequence numbers
+ * increase and that the last one arrives.
+ * A deterministic case runs the producer between the consumer reading
+ * tail and claiming the element, through MONITOR_QUEUE_POLL_HOOK.
+ *
+ * usage: testMonitorQueue [count]
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <stdexcept>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/monitor.h>
+
+// run by MonitorElementQueue::poll, once, if set
+static void (*pollHook)(void *) = 0;
+static void *pollHookArg = 0;
+static void runPollHook()
+{
+    void (*hook)(void *) = pollHook;
+    pollHook = 0;
+    if(hook) hook(pollHookArg);
+}
+#define MONITOR_QUEUE_POLL_HOOK() runPollHook()
+
+#include "monitorElementQueue.h"
+
+using namespace epics::pvData;
+using namespace epics::pvaSrv;
+
+enum Policy {waitPolicy, squashPolicy, dropOldestPolicy};
+static const char *policyNames[] = {"wait", "squash", "dropOldest"};
+
+struct QueueTest {
+    QueueTest(size_t queueSize, int64 count, Policy policy);
+    MonitorElementQueue queue;
+    int64 count;
+    Policy policy;
+    epicsEventId done;
+};
+
+QueueTest::QueueTest(size_t queueSize, int64 count, Policy policy)
+: count(count),
+  policy(policy),
+  done(epicsEventMustCreate(epicsEventEmpty))
+{
+    StructureConstPtr structure = getFieldCreate()->createFieldBuilder()->
+        add("value", pvLong)->
+        createStructure();
+    MonitorElementPtrArray elements;
+    for(size_t i=0; i<queueSize; i++) {
+        MonitorElementPtr element(new MonitorElement(
+            getPVDataCreate()->createPVStructure(structure)));
+        elements.push_back(element);
+    }
+    queue.setElements(elements);
+}
+
+static void producer(void *arg)
+{
+    QueueTest *test = static_cast<QueueTest *>(arg);
+    MonitorElementQueue &queue = test->queue;
+    bool held = false;
+    for(int64 seq=1; seq<=test->count; seq++) {
+        queue.getCurrent()->pvStructurePtr->getSubField<PVLong>("value")->put(seq);
+        held = false;
+        if(test->policy==waitPolicy) {
+            while(!queue.getNext()) epicsThreadSleep(0.0);
+        }
+        if(queue.getNext()) {
+            queue.publish();
+            continue;
+        }
+        if(test->policy==dropOldestPolicy && queue.dropOldest()) {
+            queue.publish();
+            continue;
+        }
+        MonitorElementPtr const & last = queue.reclaimLast();
+        if(last) {
+            last->pvStructurePtr->getSubField<PVLong>("value")->put(seq);
+            queue.requeueLast();
+            continue;
+        }
+        held = true;
+    }
+    if(held) {
+        while(!queue.getNext()) epicsThreadSleep(0.0);
+        queue.publish();
+    }
+    epicsEventSignal(test->done);
+}
+
+static int runTest(size_t queueSize, int64 count, Policy policy)
+{
+    QueueTest test(queueSize, count, policy);
+    epicsTimeStamp startTime, endTime;
+    epicsTimeGetCurrent(&startTime);
+    epicsThreadCreate("producer", epicsThreadPriorityMedium,
+        epicsThreadGetStackSize(epicsThreadStackMedium),
+        producer, &test);
+    int errors = 0;
+    int64 expected = 1;
+    int64 received = 0;
+    while(expected<=count) {
+        MonitorElementPtr element = test.queue.poll();
+        if(!element) {
+            epicsThreadSleep(0.0);
+            continue;
+        }
+        received++;
+        int64 seq = element->pvStructurePtr->getSubField<PVLong>("value")->get();
+        bool ok = policy==waitPolicy ? seq==expected : seq>=expected;
+        if(!ok) {
+            if(errors<10) printf("queueSize %lu expected %lld got %lld\n",
+                (unsigned long)queueSize, (long long)expected, (long long)seq);
+            errors++;
+        }
+        if(seq>expected) expected = seq;
+        expected++;
+        test.queue.release(element);
+    }
+    epicsEventMustWait(test.done);
+    if(test.queue.poll()) {
+        printf("queueSize %lu extra element after last\n",
+            (unsigned long)queueSize);
+        errors++;
+    }
+    epicsTimeGetCurrent(&endTime);
+    double seconds = epicsTimeDiffInSeconds(&endTime, &startTime);
+    printf("%s queueSize %lu count %lld received %lld errors %d elements/sec %.0f\n",
+        policyNames[policy], (unsigned long)queueSize, (long long)count,
+        (long long)received, errors,
+        seconds>0.0 ? count/seconds : 0.0);
+    epicsEventDestroy(test.done);
+    return errors;
+}
+
+static void setValue(MonitorElementPtr const & element, int64 seq)
+{
+    element->pvStructurePtr->getSubField<PVLong>("value")->put(seq);
+}
+
+static int64 getValue(MonitorElementPtr const & element)
+{
+    return element->pvStructurePtr->getSubField<PVLong>("value")->get();
+}
+
+// Two dropOldest cycles, which queue the slot of the oldest element again
+static void dropTwice(void *arg)
+{
+    QueueTest *test = static_cast<QueueTest *>(arg);
+    for(int i=0; i<2; i++) {
+        setValue(test->queue.getCurrent(), ++test->count);
+        test->queue.dropOldest();
+        test->queue.publish();
+    }
+}
+
+/* The consumer reads tail, then the producer drops the oldest element
+ * twice and so queues its slot again as the newest element. The consumer
+ * must still get the elements oldest first.
+ */
+static int runPreemptTest(size_t queueSize)
+{
+    QueueTest test(queueSize, 0, dropOldestPolicy);
+    MonitorElementQueue &queue = test.queue;
+    while(queue.getNext()) {
+        setValue(queue.getCurrent(), ++test.count);
+        queue.publish();
+    }
+    int errors = 0;
+    int64 expected = 3;
+    pollHook = dropTwice;
+    pollHookArg = &test;
+    try {
+        while(true) {
+            MonitorElementPtr element = queue.poll();
+            if(!element) break;
+            int64 seq = getValue(element);
+            if(seq!=expected) {
+                printf("preempt queueSize %lu expected %lld got %lld\n",
+                    (unsigned long)queueSize, (long long)expected,
+                    (long long)seq);
+                errors++;
+            }
+            expected = seq+1;
+            queue.release(element);
+        }
+    } catch(std::logic_error const & e) {
+        printf("preempt queueSize %lu %s\n", (unsigned long)queueSize, e.what());
+        errors++;
+    }
+    pollHook = 0;
+    if(expected!=test.count+1) {
+        printf("preempt queueSize %lu last %lld of %lld\n",
+            (unsigned long)queueSize, (long long)expected-1,
+            (long long)test.count);
+        errors++;
+    }
+    printf("preempt queueSize %lu errors %d\n", (unsigned long)queueSize, errors);
+    epicsEventDestroy(test.done);
+    return errors;
+}
+
+int main(int argc,char *argv[])
+{
+    int64 count = 1000000;
+    if(argc>=2) count = atoll(argv[1]);
+    const size_t queueSizes[] = {2, 3, 4, 16, 1024};
+    int errors = 0;
+    errors += runPreemptTest(2);
+    errors += runPreemptTest(3);
+    for(int policy=waitPolicy; policy<=dropOldestPolicy; policy++) {
+        for(size_t i=0; i<sizeof(queueSizes)/sizeof(queueSizes[0]); i++) {
+            errors += runTest(queueSizes[i], count, Policy(policy));
+        }
+    }
+    printf("testMonitorQueue %s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
+}
@@ -29,6 +29,7 @@ dbLoadRecords("db/dbBigstringin.db","name=bigstring01")
 dbLoadRecords("db/dbStringArray.db","name=stringArray01")
 dbLoadRecords("db/dbEnum.db","name=enum01")
 dbLoadRecords("db/dbCounter.db","name=counter01");
+dbLoadRecords("db/dbCompress.db","name=compress01,input=counter01")
 
 dbLoadRecords("db/dbInteger.db","name=byte02,type=byter")
 dbLoadRecords("db/dbInteger.db","name=short02,type=shortr")
@@ -68,6 +69,10 @@ dbLoadRecords("db/dbStringArray.db","name=stringArray03")
 dbLoadRecords("db/dbEnum.db","name=enum03")
 dbLoadRecords("db/dbCounter.db","name=counter03");
 
+## Statistics of the dbPv provider (Base 3.15 and later)
+#var dbPvStatsEnable 1
+#dbLoadRecords("db/dbPvStats.db","P=dbPvStats:")
+
 cd ${TOP}/iocBoot/${IOC}
 iocInit()
 epicsThreadSleep(2.0)